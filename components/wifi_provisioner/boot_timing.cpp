@@ -0,0 +1,176 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <algorithm>
+#include <cstring>
+
+#include "boot_timing.hpp"
+
+#define BOOT_TIMING_NVS_NAMESPACE "wifi_prov"
+#define BOOT_TIMING_NVS_KEY "boot_hist"
+
+// Bei einer Änderung des Formats wird ein vorhandener Verlauf verworfen
+#define BOOT_TIMING_VERSION 1
+
+// Task, der den Verlauf einmal pro Start schreibt (NVS-Zugriffe brauchen etwas Stack)
+#define BOOT_TIMING_TASK_STACK_SIZE 3072
+#define BOOT_TIMING_TASK_PRIORITY 2
+
+struct boot_history_t {
+    uint8_t version;
+    uint8_t count;  // Belegte Einträge
+    uint8_t next;   // Nächster zu schreibender Eintrag
+    boot_timing_t entries[BOOT_TIMING_HISTORY_LEN];
+};
+
+static const char *TAG = "BOOT_TIMING";
+static boot_timing_t s_current = {};
+// Platz des laufenden Starts im Ringpuffer, -1 = noch nicht gespeichert
+static int s_slot = -1;
+// Wartet auf die letzte Phase und schreibt dann (siehe boot_timing_schedule_save())
+static TaskHandle_t s_save_task = nullptr;
+static uint32_t s_save_timeout_ms = 0;
+
+static const char *const s_phase_names[BOOT_PHASE_COUNT] = {
+    "nvs_init", "wifi_init", "sta_start", "associated", "got_ip", "sntp_sync"
+};
+
+void boot_timing_mark(boot_phase_t phase) {
+    if (phase >= BOOT_PHASE_COUNT || s_current.phase_ms[phase] != 0) {
+        return;
+    }
+    // Mindestens 1, damit 0 weiterhin "nicht erreicht" bedeutet
+    s_current.phase_ms[phase] = std::max<uint32_t>(1, (uint32_t)(esp_timer_get_time() / 1000));
+    ESP_LOGD(TAG, "%s at %u ms", s_phase_names[phase], (unsigned)s_current.phase_ms[phase]);
+
+    // Alle Phasen bekannt: den wartenden Task sofort schreiben lassen. Läuft z.B. im SNTP-Callback,
+    // daher hier nur die Benachrichtigung und kein NVS-Zugriff.
+    if (phase == BOOT_PHASE_COUNT - 1 && s_save_task != nullptr) {
+        xTaskNotifyGive(s_save_task);
+    }
+}
+
+static void boot_timing_save_task(void *arg) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(s_save_timeout_ms));
+    boot_timing_save();
+    s_save_task = nullptr;
+    vTaskDelete(NULL);
+}
+
+esp_err_t boot_timing_schedule_save(uint32_t timeout_ms) {
+    if (s_save_task != nullptr || s_slot >= 0) {
+        return ESP_OK;
+    }
+    s_save_timeout_ms = timeout_ms;
+    if (xTaskCreate(boot_timing_save_task, "boot_timing", BOOT_TIMING_TASK_STACK_SIZE, NULL,
+                    BOOT_TIMING_TASK_PRIORITY, &s_save_task) != pdPASS) {
+        s_save_task = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+    // Die letzte Phase kann schon vor dem Anlegen des Tasks erreicht worden sein
+    if (s_current.phase_ms[BOOT_PHASE_COUNT - 1] != 0) {
+        xTaskNotifyGive(s_save_task);
+    }
+    return ESP_OK;
+}
+
+void boot_timing_set_flags(uint32_t flags) {
+    s_current.flags |= flags;
+}
+
+const boot_timing_t& boot_timing_current() {
+    return s_current;
+}
+
+const char *boot_phase_name(boot_phase_t phase) {
+    return phase < BOOT_PHASE_COUNT ? s_phase_names[phase] : "?";
+}
+
+/**
+ * @brief Liest den Verlauf; ein fehlender oder veralteter Blob ergibt einen leeren Verlauf.
+ */
+static void load_history(nvs_handle_t h, boot_history_t *history) {
+    size_t size = sizeof(*history);
+    if (nvs_get_blob(h, BOOT_TIMING_NVS_KEY, history, &size) != ESP_OK || size != sizeof(*history) ||
+        history->version != BOOT_TIMING_VERSION || history->count > BOOT_TIMING_HISTORY_LEN ||
+        history->next >= BOOT_TIMING_HISTORY_LEN) {
+        memset(history, 0, sizeof(*history));
+        history->version = BOOT_TIMING_VERSION;
+    }
+}
+
+esp_err_t boot_timing_save() {
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(BOOT_TIMING_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    boot_history_t history;
+    load_history(h, &history);
+    if (s_slot < 0) {
+        s_slot = history.next;
+        history.next = (history.next + 1) % BOOT_TIMING_HISTORY_LEN;
+        history.count = std::min<uint8_t>(history.count + 1, BOOT_TIMING_HISTORY_LEN);
+    }
+    history.entries[s_slot] = s_current;
+
+    err = nvs_set_blob(h, BOOT_TIMING_NVS_KEY, &history, sizeof(history));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save boot timing (%s)", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t boot_timing_get_summary(boot_timing_summary_t *summary) {
+    memset(summary, 0, sizeof(*summary));
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(BOOT_TIMING_NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err != ESP_OK) return err;
+    boot_history_t history;
+    load_history(h, &history);
+    nvs_close(h);
+
+    for (int phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+        uint32_t samples[BOOT_TIMING_HISTORY_LEN];
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < history.count; i++) {
+            const boot_timing_t& entry = history.entries[i];
+            if (entry.flags & BOOT_TIMING_FLAG_PROVISIONING) continue;
+            if (entry.phase_ms[phase] != 0) samples[n++] = entry.phase_ms[phase];
+        }
+        if (n == 0) continue;
+
+        std::sort(samples, samples + n);
+        boot_phase_stats_t& stats = summary->phases[phase];
+        stats.min_ms = samples[0];
+        stats.median_ms = (n % 2) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+        stats.max_ms = samples[n - 1];
+        stats.samples = n;
+    }
+    for (uint8_t i = 0; i < history.count; i++) {
+        if (!(history.entries[i].flags & BOOT_TIMING_FLAG_PROVISIONING)) summary->boots++;
+    }
+    return ESP_OK;
+}
+
+void boot_timing_log_summary() {
+    boot_timing_summary_t summary;
+    bool have_summary = boot_timing_get_summary(&summary) == ESP_OK;
+
+    ESP_LOGI(TAG, "Phase        this boot      min   median      max  (ms since boot, %u boots)",
+             have_summary ? summary.boots : 0);
+    for (int phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+        const boot_phase_stats_t& stats = summary.phases[phase];
+        if (have_summary && stats.samples > 0) {
+            ESP_LOGI(TAG, "%-12s %9u %8u %8u %8u", s_phase_names[phase], (unsigned)s_current.phase_ms[phase],
+                     (unsigned)stats.min_ms, (unsigned)stats.median_ms, (unsigned)stats.max_ms);
+        } else {
+            ESP_LOGI(TAG, "%-12s %9u        -        -        -", s_phase_names[phase],
+                     (unsigned)s_current.phase_ms[phase]);
+        }
+    }
+}
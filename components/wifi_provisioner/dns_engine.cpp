@@ -0,0 +1,174 @@
+#include "dns_engine.hpp"
+#include "dns_probe_table.hpp"
+#include <cstring>
+
+// DNS-Header-Flags (Byte 2 und 3 des Headers)
+#define DNS_FLAGS_OFFSET 2
+#define DNS_FLAG_QR 0x80          // Byte 2: Query Response
+#define DNS_FLAG_RD 0x01          // Byte 2: Recursion Desired
+#define DNS_OPCODE_MASK 0x78      // Byte 2: Opcode (4 Bit)
+#define DNS_FLAG_RA 0x80          // Byte 3: Recursion Available
+#define DNS_QDCOUNT_OFFSET 4
+#define DNS_ANCOUNT_OFFSET 6
+#define DNS_NSCOUNT_OFFSET 8
+#define DNS_ARCOUNT_OFFSET 10
+
+// Response Codes (RFC 1035, Abschnitt 4.1.1)
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_FORMERR 1
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_RCODE_NOTIMP 4
+#define DNS_RCODE_REFUSED 5
+
+// Answer-Sektion
+#define DNS_COMPRESSION_POINTER 0xC0
+#define DNS_COMPRESSION_OFFSET 0x0C
+
+// Record-Typen und Klassen
+#define DNS_TYPE_A 1
+#define DNS_TYPE_AAAA 28
+#define DNS_TYPE_SVCB 64
+#define DNS_TYPE_HTTPS 65
+#define DNS_TYPE_ANY 255
+#define DNS_CLASS_IN 1
+#define DNS_CLASS_ANY 255
+
+//  Zeit- und Längenangaben (TTL & RDLENGTH)
+#define DNS_ANSWER_TTL_S 120 // Time-To-Live in Sekunden
+#define DNS_RDLENGTH_IPV4 4
+#define DNS_RDLENGTH_IPV6 16
+
+// Längste erlaubte Label-Länge laut RFC 1035
+#define DNS_MAX_LABEL_LEN 63
+
+/**
+ * @brief Sucht das Ende des QNAME der ersten Frage.
+ * @return Länge des QNAME inkl. Null-Byte, oder 0, wenn das Paket ungültig ist.
+ */
+static size_t qname_length(const uint8_t *packet, size_t len) {
+    size_t pos = DNS_HEADER_SIZE;
+    while (pos < len) {
+        uint8_t label_len = packet[pos];
+        if (label_len == 0) {
+            return pos - DNS_HEADER_SIZE + 1;
+        }
+        // Komprimierungs-Pointer sind in der Question-Sektion einer Anfrage nicht üblich
+        if (label_len > DNS_MAX_LABEL_LEN) {
+            return 0;
+        }
+        pos += label_len + 1;
+    }
+    return 0;
+}
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline void write_u16(uint8_t *p, uint16_t value) {
+    p[0] = value >> 8;
+    p[1] = value & 0xFF;
+}
+
+// Answer-Record (ohne Adresse) für alle Namen außerhalb der Probe-Tabelle
+static const uint8_t s_default_a_suffix[DNS_RR_FIXED_LEN] = {
+    DNS_COMPRESSION_POINTER, DNS_COMPRESSION_OFFSET,
+    0x00, DNS_TYPE_A,
+    0x00, DNS_CLASS_IN,
+    (DNS_ANSWER_TTL_S >> 24) & 0xFF, (DNS_ANSWER_TTL_S >> 16) & 0xFF, (DNS_ANSWER_TTL_S >> 8) & 0xFF, DNS_ANSWER_TTL_S & 0xFF,
+    0x00, DNS_RDLENGTH_IPV4,
+};
+
+/**
+ * @brief Wandelt den Header der Anfrage in einen Antwort-Header um.
+ * Die ID und das RD-Bit bleiben erhalten, alle Zähler werden neu gesetzt.
+ */
+static void finish_header(uint8_t *packet, uint8_t rcode, uint16_t qdcount, uint16_t ancount) {
+    packet[DNS_FLAGS_OFFSET] = DNS_FLAG_QR | (packet[DNS_FLAGS_OFFSET] & (DNS_OPCODE_MASK | DNS_FLAG_RD));
+    packet[DNS_FLAGS_OFFSET + 1] = DNS_FLAG_RA | rcode;
+    write_u16(packet + DNS_QDCOUNT_OFFSET, qdcount);
+    write_u16(packet + DNS_ANCOUNT_OFFSET, ancount);
+    write_u16(packet + DNS_NSCOUNT_OFFSET, 0);
+    write_u16(packet + DNS_ARCOUNT_OFFSET, 0);
+}
+
+void DnsEngine::set_ap_ip6(const uint8_t *ip6) {
+    _has_ip6 = ip6 != nullptr;
+    if (_has_ip6) {
+        memcpy(_ap_ip6, ip6, sizeof(_ap_ip6));
+    }
+}
+
+size_t DnsEngine::handle_query(uint8_t *packet, size_t len, size_t capacity) {
+    _stats.queries++;
+
+    // Ignoriere zu kurze Pakete und Anfragen, die bereits Antworten sind
+    if (len < DNS_HEADER_SIZE || (packet[DNS_FLAGS_OFFSET] & DNS_FLAG_QR) != 0) {
+        if (len < DNS_HEADER_SIZE) _stats.malformed++;
+        _stats.ignored++;
+        return 0;
+    }
+
+    // Nur Standard-Anfragen (Opcode QUERY) werden unterstützt
+    if ((packet[DNS_FLAGS_OFFSET] & DNS_OPCODE_MASK) != 0) {
+        finish_header(packet, DNS_RCODE_NOTIMP, 0, 0);
+        _stats.errors++;
+        return DNS_HEADER_SIZE;
+    }
+
+    // Genau eine Frage mit vollständigem QNAME, QTYPE und QCLASS
+    size_t qname_len = qname_length(packet, len);
+    size_t question_end = DNS_HEADER_SIZE + qname_len + DNS_QUESTION_SUFFIX_SIZE;
+    if (read_u16(packet + DNS_QDCOUNT_OFFSET) != 1 || qname_len == 0 || question_end > len) {
+        finish_header(packet, DNS_RCODE_FORMERR, 0, 0);
+        _stats.errors++;
+        _stats.malformed++;
+        return DNS_HEADER_SIZE;
+    }
+
+    uint16_t qtype = read_u16(packet + question_end - DNS_QUESTION_SUFFIX_SIZE);
+    uint16_t qclass = read_u16(packet + question_end - DNS_QUESTION_SUFFIX_SIZE + 2);
+
+    if (qclass != DNS_CLASS_IN && qclass != DNS_CLASS_ANY) {
+        finish_header(packet, DNS_RCODE_REFUSED, 1, 0);
+        _stats.errors++;
+        return question_end;
+    }
+
+    // Konnektivitäts-Checks über die Tabelle, alle anderen Namen optional mit NXDOMAIN
+    const dns_probe::Entry *probe = dns_probe::lookup(packet + DNS_HEADER_SIZE, qname_len);
+    if (probe != nullptr) {
+        _stats.probe_hits++;
+    } else if (_nxdomain_unknown) {
+        finish_header(packet, DNS_RCODE_NXDOMAIN, 1, 0);
+        _stats.nxdomain++;
+        return question_end;
+    }
+
+    // Passenden Record wählen. Alles hinter der Frage (z.B. EDNS-OPT) wird einfach überschrieben.
+    uint8_t *p = packet + question_end;
+    if ((qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY) &&
+        question_end + DNS_RR_FIXED_LEN + DNS_RDLENGTH_IPV4 <= capacity) {
+        // Vorgefertigter Answer-Record plus Adresse
+        memcpy(p, probe != nullptr ? probe->a_suffix : s_default_a_suffix, DNS_RR_FIXED_LEN);
+        memcpy(p + DNS_RR_FIXED_LEN, &_ap_ip, DNS_RDLENGTH_IPV4);
+        finish_header(packet, DNS_RCODE_NOERROR, 1, 1);
+        _stats.answered++;
+        return question_end + DNS_RR_FIXED_LEN + DNS_RDLENGTH_IPV4;
+    }
+
+    if (qtype == DNS_TYPE_AAAA && _has_ip6 &&
+        question_end + DNS_RR_FIXED_LEN + DNS_RDLENGTH_IPV6 <= capacity) {
+        uint32_t ttl = probe != nullptr ? probe->ttl_s : DNS_ANSWER_TTL_S;
+        dns_probe::build_rr_header(p, DNS_TYPE_AAAA, ttl, DNS_RDLENGTH_IPV6);
+        memcpy(p + DNS_RR_FIXED_LEN, _ap_ip6, DNS_RDLENGTH_IPV6);
+        finish_header(packet, DNS_RCODE_NOERROR, 1, 1);
+        _stats.answered++;
+        return question_end + DNS_RR_FIXED_LEN + DNS_RDLENGTH_IPV6;
+    }
+
+    // AAAA ohne IPv6, HTTPS/SVCB und sonstige Typen: Der Name existiert, hat aber keinen solchen Record
+    finish_header(packet, DNS_RCODE_NOERROR, 1, 0);
+    _stats.nodata++;
+    return question_end;
+}
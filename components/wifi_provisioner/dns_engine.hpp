@@ -0,0 +1,87 @@
+/**
+ * @file dns_engine.hpp
+ * @brief Socket-unabhängiger Kern des Captive-DNS-Servers.
+ *
+ * Die Engine kennt weder lwIP noch FreeRTOS: Sie bekommt ein empfangenes Datagramm als Byte-Puffer
+ * und baut die Antwort direkt im selben Puffer auf. Dadurch läuft derselbe Code auf dem ESP32
+ * (`dns_server.cpp`) und auf dem Linux-Host (Benchmark unter `host/`).
+ *
+ * Antworten je QTYPE:
+ * - A / ANY:        die IPv4-Adresse des Access Points
+ * - AAAA:           die konfigurierte IPv6-Adresse, sonst eine leere NOERROR-Antwort (NODATA)
+ * - HTTPS / SVCB:   sofort NODATA, damit Clients ohne Timeout auf A/AAAA zurückfallen
+ * - alle anderen:   NODATA
+ * Fehlerhafte Pakete erhalten FORMERR, andere Opcodes NOTIMP und andere Klassen als IN REFUSED.
+ *
+ * Bekannte Konnektivitäts-Check-Domains (captive.apple.com, connectivitycheck.gstatic.com, ...) werden
+ * über eine perfekt gehashte Tabelle mit eigener TTL beantwortet (siehe dns_probe_table.hpp). Optional
+ * erhalten alle anderen Namen NXDOMAIN, damit Hintergrund-Traffic von Apps den Webserver nicht erreicht.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Maximale Größe eines DNS-Pakets über UDP (ohne EDNS)
+#define DNS_MAX_LEN 512
+
+// DNS-Header
+#define DNS_HEADER_SIZE 12
+#define DNS_QUESTION_SUFFIX_SIZE 4 // QTYPE (2 bytes) + QCLASS (2 bytes)
+#define DNS_RR_FIXED_LEN 12        // Pointer (2) + TYPE (2) + CLASS (2) + TTL (4) + RDLENGTH (2)
+
+class DnsEngine {
+public:
+    struct Stats {
+        uint32_t queries = 0;   // Anzahl der übergebenen Datagramme
+        uint32_t answered = 0;  // Antworten mit A- oder AAAA-Record
+        uint32_t nodata = 0;    // Leere NOERROR-Antworten (z.B. AAAA ohne IPv6, HTTPS)
+        uint32_t errors = 0;    // Antworten mit FORMERR, NOTIMP oder REFUSED
+        uint32_t ignored = 0;   // Antworten anderer Server oder zu kurze Pakete
+        uint32_t probe_hits = 0; // Anfragen nach Namen aus der Konnektivitäts-Check-Tabelle
+        uint32_t nxdomain = 0;  // Mit NXDOMAIN beantwortete unbekannte Namen
+        uint32_t malformed = 0; // Zu kurze oder fehlerhafte Pakete (ignoriert bzw. FORMERR)
+    };
+
+    /**
+     * @param ap_ip IPv4-Adresse, die jede A-Anfrage als Antwort erhält (Netzwerk-Byte-Reihenfolge,
+     * wie in `esp_ip4_addr_t::addr`).
+     */
+    explicit DnsEngine(uint32_t ap_ip = 0) : _ap_ip(ap_ip) {}
+
+    void set_ap_ip(uint32_t ap_ip) { _ap_ip = ap_ip; }
+
+    /**
+     * @brief Setzt die IPv6-Adresse für AAAA-Antworten. `nullptr` beantwortet AAAA mit NODATA.
+     * @param ip6 16 Bytes in Netzwerk-Byte-Reihenfolge.
+     */
+    void set_ap_ip6(const uint8_t *ip6);
+
+    /**
+     * @brief Beantwortet Namen, die nicht in der Konnektivitäts-Check-Tabelle stehen, mit NXDOMAIN.
+     *
+     * Standardmäßig aus: Dann zeigt jeder Name auf den Access Point, sodass auch eine im Browser
+     * eingetippte Adresse auf dem Portal landet.
+     */
+    void set_nxdomain_unknown(bool enable) { _nxdomain_unknown = enable; }
+
+    /**
+     * @brief Verarbeitet eine DNS-Anfrage und überschreibt sie mit der Antwort.
+     *
+     * @param packet Das empfangene Datagramm; enthält nach dem Aufruf die Antwort.
+     * @param len Länge des Datagramms.
+     * @param capacity Größe des Puffers (die Antwort kann länger als die Anfrage sein).
+     * @return Länge der Antwort in Bytes, oder 0, wenn nicht geantwortet werden soll.
+     */
+    size_t handle_query(uint8_t *packet, size_t len, size_t capacity);
+
+    const Stats& stats() const { return _stats; }
+    void reset_stats() { _stats = Stats(); }
+
+private:
+    uint32_t _ap_ip;
+    uint8_t _ap_ip6[16] = {};
+    bool _has_ip6 = false;
+    bool _nxdomain_unknown = false;
+    Stats _stats;
+};
@@ -0,0 +1,221 @@
+/**
+ * @file dns_probe_table.hpp
+ * @brief Zur Compile-Zeit erzeugte, perfekt gehashte Tabelle der Konnektivitäts-Check-Domains.
+ *
+ * Betriebssysteme prüfen direkt nach der Verbindung über feste Hostnamen, ob ein Captive Portal
+ * vorliegt. Diese Namen stehen hier mit eigener TTL und einem vorgefertigten Answer-Record, sodass
+ * die Engine sie mit einem Hash-Zugriff und einem memcpy beantworten kann.
+ *
+ * Der Hash wird nicht über jedes Zeichen gebildet, sondern aus der Länge, den ersten 16 und den
+ * letzten 8 Bytes des QNAME im Wire-Format (ASCII-Groß/Kleinschreibung über `| 0x20` angeglichen).
+ * Die Engine braucht dafür nach dem Durchlaufen der Labels nur drei Lesezugriffe. Die Slot-Funktion
+ * `(hash * seed) >> shift` ist für die Namen in der Tabelle kollisionsfrei; der Seed wird vom Compiler
+ * gesucht, ein Treffer wird anschließend Byte für Byte verifiziert.
+ */
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace dns_probe {
+
+// Record-Typ A, Klasse IN (siehe dns_engine.cpp)
+constexpr uint16_t TYPE_A = 1;
+constexpr uint16_t CLASS_IN = 1;
+
+// Länge eines Answer-Records ohne RDATA: Pointer + TYPE + CLASS + TTL + RDLENGTH
+constexpr size_t RR_FIXED_LEN = 12;
+
+// Maximale Länge eines Namens in der Tabelle (Wire-Format inkl. Null-Byte)
+constexpr size_t MAX_WIRE_LEN = 40;
+
+struct ProbeName {
+    const char *name;
+    uint32_t ttl_s;
+};
+
+// Kurze TTLs: Diese Antworten sollen nach dem Verlassen des Setup-WLANs nicht im Cache bleiben.
+constexpr ProbeName names[] = {
+    // Apple (iOS, macOS)
+    {"captive.apple.com", 10},
+    {"www.apple.com", 10},
+    {"www.appleiphonecell.com", 10},
+    {"www.airport.us", 10},
+    {"www.ibook.info", 10},
+    {"www.itools.info", 10},
+    {"www.thinkdifferent.us", 10},
+    // Android / ChromeOS
+    {"connectivitycheck.gstatic.com", 10},
+    {"connectivitycheck.android.com", 10},
+    {"clients1.google.com", 10},
+    {"clients3.google.com", 10},
+    {"www.google.com", 10},
+    {"play.googleapis.com", 10},
+    // Windows (NCSI)
+    {"www.msftconnecttest.com", 10},
+    {"ipv6.msftconnecttest.com", 10},
+    {"www.msftncsi.com", 10},
+    {"dns.msftncsi.com", 10},
+    // Firefox
+    {"detectportal.firefox.com", 10},
+    // Linux (NetworkManager, systemd)
+    {"nmcheck.gnome.org", 10},
+    {"network-test.debian.org", 10},
+    {"connectivity-check.ubuntu.com", 10},
+    {"fedoraproject.org", 10},
+};
+
+constexpr size_t NUM_NAMES = sizeof(names) / sizeof(names[0]);
+
+constexpr unsigned SLOT_BITS = 6;
+constexpr size_t NUM_SLOTS = size_t(1) << SLOT_BITS;
+static_assert(NUM_NAMES < NUM_SLOTS, "Probe table too small");
+
+constexpr uint8_t ascii_lower(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? uint8_t(c + ('a' - 'A')) : c;
+}
+
+/**
+ * @brief Liest bis zu 8 Bytes als Little-Endian-Wert und gleicht die Schreibweise an.
+ * Label-Längen werden dabei ebenfalls verändert, das ist für den Hash unerheblich.
+ */
+constexpr uint64_t load_folded(const uint8_t *p, size_t n) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < n && i < 8; i++) v |= uint64_t(p[i] | 0x20) << (8 * i);
+    return v;
+}
+
+/**
+ * @brief Hash eines QNAME im Wire-Format (inkl. Null-Byte).
+ */
+constexpr uint32_t hash_qname(const uint8_t *qname, size_t len) {
+    uint64_t head = load_folded(qname, len);
+    uint64_t middle = len > 8 ? load_folded(qname + 8, len - 8) : 0;
+    uint64_t tail = len > 16 ? load_folded(qname + len - 8, 8) : 0;
+    uint64_t h = (head * 0x9E3779B97F4A7C15ull) ^ (middle * 0xC2B2AE3D27D4EB4Full) ^
+                 (tail * 0x165667B19E3779F9ull) ^ len;
+    return uint32_t(h ^ (h >> 29) ^ (h >> 47));
+}
+
+/**
+ * @brief Laufzeit-Variante von hash_qname() mit 8-Byte-Lesezugriffen.
+ * Liefert auf Little-Endian-Zielen (ESP32, x86) denselben Wert wie die constexpr-Variante.
+ */
+inline uint32_t hash_qname_fast(const uint8_t *qname, size_t len) {
+    if (len <= 16) return hash_qname(qname, len);
+    uint64_t head, middle, tail;
+    memcpy(&head, qname, 8);
+    memcpy(&middle, qname + 8, 8);
+    memcpy(&tail, qname + len - 8, 8);
+    constexpr uint64_t fold = 0x2020202020202020ull;
+    uint64_t h = ((head | fold) * 0x9E3779B97F4A7C15ull) ^ ((middle | fold) * 0xC2B2AE3D27D4EB4Full) ^
+                 ((tail | fold) * 0x165667B19E3779F9ull) ^ len;
+    return uint32_t(h ^ (h >> 29) ^ (h >> 47));
+}
+
+constexpr size_t slot_of(uint32_t hash, uint32_t seed) {
+    return size_t((hash * seed) >> (32 - SLOT_BITS));
+}
+
+struct Entry {
+    uint8_t wire[MAX_WIRE_LEN];      // Name im Wire-Format, kleingeschrieben
+    uint8_t wire_len;
+    uint32_t hash;
+    uint8_t a_suffix[RR_FIXED_LEN];  // Vorgefertigter Answer-Record ohne IPv4-Adresse
+    uint32_t ttl_s;
+};
+
+/**
+ * @brief Baut den festen Teil eines Answer-Records (Pointer auf die Frage, TYPE, CLASS, TTL, RDLENGTH).
+ */
+constexpr void build_rr_header(uint8_t *out, uint16_t type, uint32_t ttl, uint16_t rdlength) {
+    out[0] = 0xC0; out[1] = 0x0C;
+    out[2] = uint8_t(type >> 8);   out[3] = uint8_t(type);
+    out[4] = uint8_t(CLASS_IN >> 8); out[5] = uint8_t(CLASS_IN);
+    out[6] = uint8_t(ttl >> 24);   out[7] = uint8_t(ttl >> 16);
+    out[8] = uint8_t(ttl >> 8);    out[9] = uint8_t(ttl);
+    out[10] = uint8_t(rdlength >> 8); out[11] = uint8_t(rdlength);
+}
+
+constexpr Entry make_entry(const ProbeName& probe) {
+    Entry e{};
+    size_t out = 0;
+    const char *s = probe.name;
+    while (*s) {
+        size_t label_len = 0;
+        while (s[label_len] && s[label_len] != '.') label_len++;
+        e.wire[out++] = uint8_t(label_len);
+        for (size_t i = 0; i < label_len; i++) e.wire[out++] = ascii_lower(uint8_t(s[i]));
+        s += label_len;
+        if (*s == '.') s++;
+    }
+    e.wire[out++] = 0;
+    e.wire_len = uint8_t(out);
+
+    e.hash = hash_qname(e.wire, out);
+
+    e.ttl_s = probe.ttl_s;
+    build_rr_header(e.a_suffix, TYPE_A, probe.ttl_s, 4);
+    return e;
+}
+
+constexpr std::array<Entry, NUM_NAMES> make_entries() {
+    std::array<Entry, NUM_NAMES> entries{};
+    for (size_t i = 0; i < NUM_NAMES; i++) entries[i] = make_entry(names[i]);
+    return entries;
+}
+
+constexpr std::array<Entry, NUM_NAMES> entries = make_entries();
+
+/**
+ * @brief Sucht den kleinsten ungeraden Multiplikator, für den alle Namen in verschiedene Slots fallen.
+ */
+constexpr uint32_t find_seed() {
+    for (uint32_t seed = 1; seed < 200000; seed += 2) {
+        bool used[NUM_SLOTS] = {};
+        bool ok = true;
+        for (size_t i = 0; i < NUM_NAMES && ok; i++) {
+            size_t slot = slot_of(entries[i].hash, seed);
+            ok = !used[slot];
+            used[slot] = true;
+        }
+        if (ok) return seed;
+    }
+    return 0;
+}
+
+constexpr uint32_t SEED = find_seed();
+static_assert(SEED != 0, "No collision-free seed found, increase SLOT_BITS");
+
+// Slot -> Index in `entries` + 1 (0 = leer)
+constexpr std::array<uint8_t, NUM_SLOTS> make_slots() {
+    std::array<uint8_t, NUM_SLOTS> slots{};
+    for (size_t i = 0; i < NUM_NAMES; i++) slots[slot_of(entries[i].hash, SEED)] = uint8_t(i + 1);
+    return slots;
+}
+
+constexpr std::array<uint8_t, NUM_SLOTS> slots = make_slots();
+
+/**
+ * @brief Sucht einen QNAME (Wire-Format) in der Tabelle.
+ * @param qname Zeiger auf den Namen im Paket.
+ * @param qname_len Länge inkl. Null-Byte.
+ * @return Der Tabelleneintrag oder nullptr.
+ */
+inline const Entry *lookup(const uint8_t *qname, size_t qname_len) {
+    uint32_t hash = hash_qname_fast(qname, qname_len);
+    uint8_t index = slots[slot_of(hash, SEED)];
+    if (index == 0) return nullptr;
+    const Entry& e = entries[index - 1];
+    if (e.hash != hash || e.wire_len != qname_len) return nullptr;
+    // Clients fragen fast immer in Kleinbuchstaben; nur sonst zeichenweise vergleichen
+    if (memcmp(qname, e.wire, qname_len) == 0) return &e;
+    for (size_t i = 0; i < qname_len; i++) {
+        if (ascii_lower(qname[i]) != e.wire[i]) return nullptr;
+    }
+    return &e;
+}
+
+} // namespace dns_probe
@@ -0,0 +1,91 @@
+/**
+ * @file dns_rate_limiter.hpp
+ * @brief Token-Bucket pro Absender-IP für den Captive-DNS-Server.
+ *
+ * Jeder Client erhält einen Eimer mit DNS_RATE_LIMIT_BURST Anfragen, der mit DNS_RATE_LIMIT_QPS
+ * Anfragen pro Sekunde nachgefüllt wird. Ein Telefon schickt direkt nach der Verbindung etwa 10-20
+ * Anfragen auf einmal und danach nur noch vereinzelte; eine App, die in einer Schleife Namen auflöst,
+ * leert ihren Eimer dagegen sofort, und ihre weiteren Anfragen werden verworfen, bevor die Engine
+ * eine Antwort aufbaut.
+ *
+ * Die Tabelle hat eine feste Größe (kein Heap). Ist sie voll, ersetzt ein neuer Client den Eintrag,
+ * der am längsten nichts gesendet hat; dessen Eimer wäre inzwischen ohnehin wieder voll. Wie die
+ * Engine kennt der Limiter weder lwIP noch FreeRTOS: Die Zeit wird übergeben, sodass er auch im
+ * Host-Benchmark läuft.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Anzahl gleichzeitig verfolgter Clients (der Access Point erlaubt höchstens 10 Stationen)
+#define DNS_RATE_LIMIT_CLIENTS 16
+// Dauerhaft erlaubte Anfragen pro Sekunde und Client
+#define DNS_RATE_LIMIT_QPS 20
+// Anfragen, die ein Client nach einer Pause auf einmal senden darf
+#define DNS_RATE_LIMIT_BURST 40
+
+class DnsRateLimiter {
+public:
+    /**
+     * @brief Entscheidet, ob eine Anfrage von `ip` beantwortet wird, und verbraucht dafür ein Token.
+     *
+     * @param ip Absenderadresse (beliebige Byte-Reihenfolge, wird nur verglichen).
+     * @param now_ms Fortlaufende Zeit in Millisekunden; ein Überlauf nach 49 Tagen ist unschädlich.
+     * @return true, wenn die Anfrage bearbeitet werden soll; false, wenn sie verworfen wird.
+     */
+    bool allow(uint32_t ip, uint32_t now_ms) {
+        Bucket *bucket = find_or_evict(ip, now_ms);
+
+        // Nachfüllen; nach einer längeren Pause ist der Eimer einfach voll
+        uint32_t elapsed_ms = now_ms - bucket->last_ms;
+        bucket->last_ms = now_ms;
+        if (elapsed_ms >= FULL_REFILL_MS) {
+            bucket->tokens = CAPACITY;
+        } else {
+            bucket->tokens += elapsed_ms * DNS_RATE_LIMIT_QPS;
+            if (bucket->tokens > CAPACITY) bucket->tokens = CAPACITY;
+        }
+
+        if (bucket->tokens < COST) {
+            return false;
+        }
+        bucket->tokens -= COST;
+        return true;
+    }
+
+    void reset() {
+        for (Bucket& bucket : _buckets) bucket = Bucket();
+    }
+
+private:
+    // Tokens in Tausendsteln einer Anfrage, damit das Nachfüllen pro Millisekunde ganzzahlig bleibt
+    static constexpr uint32_t COST = 1000;
+    static constexpr uint32_t CAPACITY = DNS_RATE_LIMIT_BURST * COST;
+    static constexpr uint32_t FULL_REFILL_MS = CAPACITY / DNS_RATE_LIMIT_QPS;
+
+    struct Bucket {
+        uint32_t ip = 0;       // 0 = frei (0.0.0.0 sendet keine Anfragen)
+        uint32_t tokens = 0;
+        uint32_t last_ms = 0;
+    };
+
+    Bucket *find_or_evict(uint32_t ip, uint32_t now_ms) {
+        Bucket *oldest = &_buckets[0];
+        for (Bucket& bucket : _buckets) {
+            if (bucket.ip == ip) return &bucket;
+            if (bucket.ip == 0) {
+                oldest = &bucket;
+                break;
+            }
+            if (now_ms - bucket.last_ms > now_ms - oldest->last_ms) oldest = &bucket;
+        }
+        // Neuer Client: voller Eimer
+        oldest->ip = ip;
+        oldest->tokens = CAPACITY;
+        oldest->last_ms = now_ms;
+        return oldest;
+    }
+
+    Bucket _buckets[DNS_RATE_LIMIT_CLIENTS];
+};
@@ -2,161 +2,282 @@
 #include "lwip/netdb.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "dns_server.hpp"
+#include "dns_engine.hpp"
+#include "dns_rate_limiter.hpp"
 
 // Standard-Port für DNS
 #define DNS_PORT 53
-#define DNS_MAX_LEN 256
 
-// DNS-Header-Flags
-#define DNS_FLAG_QR (1 << 7)
-#define DNS_FLAG_RA (1 << 15)
+// Wie lange select() höchstens blockiert, bevor das Stopp-Signal geprüft wird
+#define DNS_SELECT_TIMEOUT_MS 100
+// Maximale Anzahl Datagramme, die pro Socket und Aufwachvorgang abgearbeitet werden,
+// damit ein Socket die anderen nicht aushungert
+#define DNS_MAX_BURST 16
+
+// Nach einem Fehler von select() (z.B. ungültiger Socket, weil das Interface weg ist) kurz warten statt
+// sofort erneut aufzurufen; bleibt der Fehler bestehen, beendet sich der Task
+#define DNS_SELECT_ERROR_BACKOFF_MS 500
+#define DNS_MAX_SELECT_ERRORS 10
 
-#define DNS_ANSWER_LEN 16
-#define DNS_HEADER_SIZE 12
-#define DNS_FLAGS_OFFSET 2
-#define DNS_ANSWER_COUNT_OFFSET 7
-#define DNS_QUESTION_SUFFIX_SIZE 4 // QTYPE (2 bytes) + QCLASS (2 bytes)
+// Wie lange stop_dns_server() auf das Ende des Tasks wartet
+#define DNS_STOP_TIMEOUT_MS (DNS_SELECT_TIMEOUT_MS * 10)
 
-// Answer-Sektion
-#define DNS_COMPRESSION_POINTER 0xC0
-#define DNS_COMPRESSION_OFFSET 0x0C
-#define DNS_TYPE_A 1
-#define DNS_CLASS_IN 1
+#define DNS_TASK_STACK_SIZE 4096
+#define DNS_TASK_PRIORITY 5
 
-//  Zeit- und Längenangaben (TTL & RDLENGTH)
-#define DNS_ANSWER_TTL_S 120 // Time-To-Live in Sekunden
-#define DNS_RDLENGTH_IPV4 4
+// Bits für die Event Group
+#define DNS_STOP_BIT    BIT0
+#define DNS_STOPPED_BIT BIT1
+
+struct dns_listener_t {
+    int fd;
+    DnsEngine engine;
+};
 
 // Statische Variablen für den Task
 static const char *TAG = "DNS_SERVER";
-static int sock_fd = -1;
-static volatile bool dns_server_running = false;
+static dns_listener_t s_listeners[DNS_MAX_LISTENERS];
+static size_t s_num_listeners = 0;
+static TaskHandle_t s_dns_task = nullptr;
+static EventGroupHandle_t s_dns_events = nullptr;
+static dns_server_stats_t s_stats = {};
+// Gemeinsam für alle Sockets: ein Client hat ein Kontingent, egal über welches Interface er fragt
+static DnsRateLimiter s_rate_limiter;
+static uint8_t s_ip6[16];
+static bool s_has_ip6 = false;
+static bool s_nxdomain_unknown = false;
 
 /**
- * @brief Erstellt eine DNS-Antwort, die auf die IP des APs verweist.
- * @param request Der ursprüngliche DNS-Request-Packet.
- * @param response Der Puffer für das DNS-Response-Packet.
- * @param ap_ip Die IP-Adresse des Access Points.
+ * @brief Erstellt einen nicht-blockierenden UDP-Socket, gebunden an die IP des Interfaces.
+ * @return Der Socket-Deskriptor oder -1 bei einem Fehler.
  */
-static void create_dns_response(uint8_t *request, uint8_t *response, const esp_ip4_addr_t *ap_ip) {
-    // Finde das Ende der "Question"-Sektion
-    uint8_t *p = request + DNS_HEADER_SIZE;
-    while (*p != 0) {
-        p += (*p + 1);
+static int open_listener(const char *ifkey, esp_ip4_addr_t *bound_ip) {
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey(ifkey);
+    esp_netif_ip_info_t ip_info;
+    if (netif == nullptr || esp_netif_get_ip_info(netif, &ip_info) != ESP_OK || ip_info.ip.addr == 0) {
+        ESP_LOGW(TAG, "Interface %s has no IP address, skipping", ifkey);
+        return -1;
+    }
+
+    // Erstelle und konfiguriere die Server-Adresse für den Socket.
+    // Jeder Socket wird an die IP seines Interfaces gebunden, damit mehrere Sockets auf Port 53 lauschen können.
+    struct sockaddr_in server_addr = {};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = ip_info.ip.addr;
+    server_addr.sin_port = htons(DNS_PORT);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to create socket for %s", ifkey);
+        return -1;
     }
-    size_t question_len = (p - (request + DNS_HEADER_SIZE)) + 1; // Länge des Domainnamens inkl. Null-Byte
 
-    // Kopiere Header und die komplette Question-Sektion (Name + Suffix)
-    size_t request_len = DNS_HEADER_SIZE + question_len + DNS_QUESTION_SUFFIX_SIZE;
-    memcpy(response, request, request_len); // Header + Question + QTYPE/QCLASS
+    if (bind(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        ESP_LOGE(TAG, "Failed to bind socket for %s", ifkey);
+        close(fd);
+        return -1;
+    }
 
-    // Setze die Flags im Header für eine Antwort
-    response[DNS_FLAGS_OFFSET] |= DNS_FLAG_QR; // Query Response
-    response[DNS_FLAGS_OFFSET ] |= DNS_FLAG_RA; // Recursion Available
+    // Nicht-blockierend, damit nach select() alle wartenden Datagramme abgeholt werden können
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
 
-    // Setze die Anzahl der Antworten auf 1
-    response[DNS_ANSWER_COUNT_OFFSET] = 1;
+    *bound_ip = ip_info.ip;
+    ESP_LOGI(TAG, "Listening on " IPSTR ":%d (%s)", IP2STR(&ip_info.ip), DNS_PORT, ifkey);
+    return fd;
+}
 
-    // Setze den Pointer an das Ende der kopierten "Question"-Sektion im Response-Puffer
-    p = response + request_len;
+/**
+ * @brief Holt alle wartenden Datagramme eines Sockets ab und beantwortet sie.
+ * @return Anzahl der abgearbeiteten Datagramme.
+ */
+static uint32_t drain_listener(dns_listener_t *listener) {
+    // Die Antwort wird direkt im Empfangspuffer aufgebaut
+    uint8_t buffer[DNS_MAX_LEN];
+    uint32_t handled = 0;
+    // Ein Burst wird innerhalb weniger Millisekunden abgearbeitet; eine Zeitabfrage genügt
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
 
-    // Füge die "Answer"-Sektion hinzu
-    *p++ = DNS_COMPRESSION_POINTER;
-    *p++ = DNS_COMPRESSION_OFFSET;
+    while (handled < DNS_MAX_BURST) {
+        struct sockaddr_in client;
+        socklen_t client_len = sizeof(client);
+        int len = recvfrom(listener->fd, buffer, sizeof(buffer), MSG_DONTWAIT,
+                           (struct sockaddr *)&client, &client_len);
+        if (len < 0) {
+            break; // EWOULDBLOCK: Socket ist leer
+        }
+        handled++;
+        s_stats.received++;
 
-    *p++ = 0x00; *p++ = DNS_TYPE_A;      // Type
-    *p++ = 0x00; *p++ = DNS_CLASS_IN;    // Class
+        // Flut eines einzelnen Clients verwerfen, bevor das Paket überhaupt gelesen wird
+        if (!s_rate_limiter.allow(client.sin_addr.s_addr, now_ms)) {
+            s_stats.rate_limited++;
+            continue;
+        }
 
-    // TTL (Time To Live) in Big-Endian (Netzwerk-Byte-Reihenfolge)
-    *p++ = (DNS_ANSWER_TTL_S >> 24) & 0xFF;
-    *p++ = (DNS_ANSWER_TTL_S >> 16) & 0xFF;
-    *p++ = (DNS_ANSWER_TTL_S >> 8) & 0xFF;
-    *p++ = DNS_ANSWER_TTL_S & 0xFF;
+        uint32_t malformed = listener->engine.stats().malformed;
+        size_t response_len = listener->engine.handle_query(buffer, len, sizeof(buffer));
+        if (listener->engine.stats().malformed != malformed) {
+            s_stats.malformed++;
+        }
+        if (response_len == 0) {
+            s_stats.ignored++;
+            continue;
+        }
 
-    // Länge der Daten (RDLENGTH)
-    *p++ = 0x00; *p++ = DNS_RDLENGTH_IPV4;
-    
-    // Füge die IP-Adresse des APs als Antwort ein
-    memcpy(p, &ap_ip->addr, DNS_RDLENGTH_IPV4);
+        if (sendto(listener->fd, buffer, response_len, MSG_DONTWAIT, (struct sockaddr *)&client, client_len) < 0) {
+            s_stats.dropped++;
+        } else {
+            s_stats.served++;
+        }
+    }
+    return handled;
 }
 
 /**
  * @brief Der FreeRTOS-Task, der den DNS-Server ausführt.
  */
 static void dns_server_task(void *pvParameters) {
-    uint8_t request_buffer[DNS_MAX_LEN];
-    uint8_t response_buffer[DNS_MAX_LEN];
-    struct sockaddr client;
-    socklen_t client_len = sizeof(client);
-
-    // Hole die IP-Informationen des Access-Point-Interfaces
-    esp_netif_ip_info_t ip_info;
-    esp_netif_get_ip_info(esp_netif_get_handle_from_ifkey("WIFI_AP_DEF"), &ip_info);
+    ESP_LOGI(TAG, "DNS Server started with %u socket(s)", (unsigned)s_num_listeners);
 
-    // Erstelle und konfiguriere die Server-Adresse für den Socket.
-    // Wir verwenden die spezifische `sockaddr`-Struktur für IPv4.
-    struct sockaddr_in server_addr;
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY; // Lausche auf allen IPs des Geräts
-    server_addr.sin_port = htons(DNS_PORT);   // Lausche auf Port 53
-
-    // Erstelle einen UDP-Socket
-    sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock_fd < 0) {
-        ESP_LOGE(TAG, "Failed to create socket");
-        vTaskDelete(NULL);
-        return;
-    }
+    // Hauptschleife: Warte auf beliebigen Socket, dann alle wartenden Anfragen abarbeiten
+    unsigned select_errors = 0;
+    while ((xEventGroupGetBits(s_dns_events) & DNS_STOP_BIT) == 0) {
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        int max_fd = -1;
+        for (size_t i = 0; i < s_num_listeners; i++) {
+            FD_SET(s_listeners[i].fd, &read_fds);
+            max_fd = std::max(max_fd, s_listeners[i].fd);
+        }
 
-    // Binde den Socket an die konfigurierte Adresse und den Port.
-    // Die bind()-Funktion erwartet einen Pointer auf die generische `sockaddr`-Struktur,
-    // daher casten wir den Pointer unserer `sockaddr`-Struktur.
-    if (bind(sock_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        ESP_LOGE(TAG, "Failed to bind socket");
-        close(sock_fd);
-        vTaskDelete(NULL);
-        return;
-    }
+        struct timeval timeout = { 0, DNS_SELECT_TIMEOUT_MS * 1000 };
+        int ready = select(max_fd + 1, &read_fds, nullptr, nullptr, &timeout);
+        if (ready < 0 && errno != EINTR) {
+            ESP_LOGW(TAG, "select() failed (errno %d)", errno);
+            if (++select_errors >= DNS_MAX_SELECT_ERRORS) {
+                ESP_LOGE(TAG, "select() keeps failing, stopping DNS server");
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(DNS_SELECT_ERROR_BACKOFF_MS));
+            continue;
+        }
+        if (ready <= 0) {
+            continue; // Timeout (Stopp-Signal prüfen) oder unterbrochener Aufruf
+        }
+        select_errors = 0;
 
-    ESP_LOGI(TAG, "DNS Server started on port %d", DNS_PORT);
-    dns_server_running = true;
-
-    // Hauptschleife zum Empfangen und Beantworten von DNS-Anfragen
-    while (dns_server_running) {
-        int len = recvfrom(sock_fd, request_buffer, sizeof(request_buffer), 0, (struct sockaddr *)&client, &client_len);
-        if (len > 0) {
-            // Ignoriere Anfragen, die bereits Antworten sind
-            if ((request_buffer[2] & DNS_FLAG_QR) == 0) {
-                create_dns_response(request_buffer, response_buffer, &ip_info.ip);
-                sendto(sock_fd, response_buffer, len + DNS_ANSWER_LEN, 0, (struct sockaddr *)&client, client_len);
+        s_stats.wakeups++;
+        uint32_t burst = 0;
+        for (size_t i = 0; i < s_num_listeners; i++) {
+            if (FD_ISSET(s_listeners[i].fd, &read_fds)) {
+                burst += drain_listener(&s_listeners[i]);
             }
         }
+        s_stats.max_burst = std::max(s_stats.max_burst, burst);
     }
 
     // Aufräumen, wenn die Schleife beendet wird
-    close(sock_fd);
-    sock_fd = -1;
+    for (size_t i = 0; i < s_num_listeners; i++) {
+        close(s_listeners[i].fd);
+        s_listeners[i].fd = -1;
+    }
+    s_num_listeners = 0;
+
+    ESP_LOGI(TAG, "DNS Server stopped (received %u, served %u, dropped %u, ignored %u, malformed %u, rate-limited %u)",
+             (unsigned)s_stats.received, (unsigned)s_stats.served, (unsigned)s_stats.dropped, (unsigned)s_stats.ignored,
+             (unsigned)s_stats.malformed, (unsigned)s_stats.rate_limited);
+
+    s_dns_task = nullptr;
+    xEventGroupSetBits(s_dns_events, DNS_STOPPED_BIT);
     vTaskDelete(NULL);
 }
 
-/**
- * @brief Startet den DNS-Server-Task.
- */
-void start_dns_server() {
-    if (!dns_server_running) {
-        xTaskCreate(dns_server_task, "dns_server", 4096, NULL, 5, NULL);
+esp_err_t start_dns_server(const char *const *ifkeys, size_t num_ifkeys) {
+    static const char *const default_ifkeys[] = { "WIFI_AP_DEF" };
+
+    if (s_dns_task != nullptr) {
+        // Ein Task, der nach stop_dns_server() noch nicht beendet ist, hält seine Sockets noch
+        if (s_dns_events != nullptr && (xEventGroupGetBits(s_dns_events) & DNS_STOP_BIT)) {
+            ESP_LOGE(TAG, "Previous DNS server task has not stopped yet");
+            return ESP_ERR_INVALID_STATE;
+        }
+        return ESP_OK;
+    }
+    if (ifkeys == nullptr || num_ifkeys == 0) {
+        ifkeys = default_ifkeys;
+        num_ifkeys = 1;
+    }
+    if (s_dns_events == nullptr) {
+        s_dns_events = xEventGroupCreate();
+        if (s_dns_events == nullptr) return ESP_ERR_NO_MEM;
     }
-}
 
-/**
- * @brief Stoppt den DNS-Server-Task.
- */
-void stop_dns_server() {
-    if (dns_server_running) {
-        dns_server_running = false;
-        // Schließe den Socket, um den blockierenden recvfrom()-Aufruf zu beenden
-        if (sock_fd != -1) {
-            shutdown(sock_fd, SHUT_RDWR);
+    // Sockets hier anlegen, damit Fehler an den Aufrufer gemeldet werden können
+    s_num_listeners = 0;
+    for (size_t i = 0; i < num_ifkeys && s_num_listeners < DNS_MAX_LISTENERS; i++) {
+        esp_ip4_addr_t ip;
+        int fd = open_listener(ifkeys[i], &ip);
+        if (fd >= 0) {
+            s_listeners[s_num_listeners].fd = fd;
+            s_listeners[s_num_listeners].engine = DnsEngine(ip.addr);
+            s_listeners[s_num_listeners].engine.set_ap_ip6(s_has_ip6 ? s_ip6 : nullptr);
+            s_listeners[s_num_listeners].engine.set_nxdomain_unknown(s_nxdomain_unknown);
+            s_num_listeners++;
         }
     }
-}
\ No newline at end of file
+    if (s_num_listeners == 0) {
+        ESP_LOGE(TAG, "No DNS socket could be opened");
+        return ESP_FAIL;
+    }
+
+    s_stats = {};
+    s_rate_limiter.reset();
+    xEventGroupClearBits(s_dns_events, DNS_STOP_BIT | DNS_STOPPED_BIT);
+    if (xTaskCreate(dns_server_task, "dns_server", DNS_TASK_STACK_SIZE, NULL, DNS_TASK_PRIORITY, &s_dns_task) != pdPASS) {
+        for (size_t i = 0; i < s_num_listeners; i++) close(s_listeners[i].fd);
+        s_num_listeners = 0;
+        s_dns_task = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t stop_dns_server() {
+    if (s_dns_task == nullptr) {
+        return ESP_OK;
+    }
+    // Signalisiere dem Task das Ende und warte, bis er seine Sockets geschlossen hat
+    xEventGroupSetBits(s_dns_events, DNS_STOP_BIT);
+    EventBits_t bits = xEventGroupWaitBits(s_dns_events, DNS_STOPPED_BIT, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(DNS_STOP_TIMEOUT_MS));
+    if ((bits & DNS_STOPPED_BIT) == 0) {
+        // DNS_STOP_BIT bleibt gesetzt: Der Task beendet sich später, bis dahin lehnt start_dns_server() ab
+        ESP_LOGW(TAG, "DNS server task did not stop within %d ms", DNS_STOP_TIMEOUT_MS);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+void dns_server_set_ip6(const uint8_t *ip6) {
+    s_has_ip6 = ip6 != nullptr;
+    if (s_has_ip6) {
+        memcpy(s_ip6, ip6, sizeof(s_ip6));
+    }
+}
+
+void dns_server_set_nxdomain_unknown(bool enable) {
+    s_nxdomain_unknown = enable;
+}
+
+void dns_server_get_stats(dns_server_stats_t *stats) {
+    *stats = s_stats;
+}
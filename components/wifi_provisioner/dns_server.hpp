@@ -0,0 +1,68 @@
+/**
+ * @file dns_server.hpp
+ * @brief Captive-DNS-Server: FreeRTOS-Task mit einem oder mehreren UDP-Sockets.
+ *
+ * Jeder Socket ist an die IP eines Netzwerk-Interfaces gebunden und beantwortet Anfragen mit
+ * genau dieser IP. Die eigentliche Paketverarbeitung erledigt `DnsEngine` (siehe dns_engine.hpp).
+ * Vorher durchläuft jedes Datagramm einen Token-Bucket pro Absender-IP (siehe dns_rate_limiter.hpp);
+ * ein Client, der den Server flutet, wird verworfen, ohne die Anfragen der anderen aufzuhalten.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+
+// Maximale Anzahl gleichzeitig bedienter Sockets (z.B. AP und STA)
+#define DNS_MAX_LISTENERS 2
+
+struct dns_server_stats_t {
+    uint32_t received;   // Empfangene Datagramme
+    uint32_t served;     // Gesendete Antworten
+    uint32_t dropped;    // Antworten, die nicht gesendet werden konnten
+    uint32_t ignored;    // Von der Engine verworfene Datagramme (Antworten, zu kurze Pakete)
+    uint32_t malformed;  // Davon bzw. mit FORMERR beantwortet: zu kurze oder fehlerhafte Anfragen
+    uint32_t rate_limited; // Ohne Bearbeitung verworfen, weil der Absender sein Kontingent überschritten hat
+    uint32_t wakeups;    // Anzahl der Aufwachvorgänge aus select()
+    uint32_t max_burst;  // Größte Anzahl an Datagrammen, die in einem Aufwachvorgang abgearbeitet wurde
+};
+
+/**
+ * @brief Startet den DNS-Server-Task.
+ *
+ * @param ifkeys Liste der Interface-Schlüssel (z.B. "WIFI_AP_DEF", "WIFI_STA_DEF"), auf deren IP ein
+ * Socket gebunden wird. `nullptr` lauscht nur auf dem Access Point.
+ * @param num_ifkeys Anzahl der Einträge in `ifkeys` (höchstens DNS_MAX_LISTENERS).
+ * @return ESP_OK, wenn mindestens ein Socket gebunden werden konnte.
+ */
+esp_err_t start_dns_server(const char *const *ifkeys = nullptr, size_t num_ifkeys = 0);
+
+/**
+ * @brief Stoppt den DNS-Server-Task und wartet, bis alle Sockets geschlossen sind.
+ * @return ESP_ERR_TIMEOUT, wenn der Task nicht rechtzeitig endet; start_dns_server() liefert dann
+ * ESP_ERR_INVALID_STATE, bis er sich beendet hat.
+ */
+esp_err_t stop_dns_server();
+
+/**
+ * @brief Legt fest, mit welcher IPv6-Adresse AAAA-Anfragen beantwortet werden.
+ *
+ * Ohne Aufruf (oder mit `nullptr`) erhalten AAAA-Anfragen sofort eine leere NOERROR-Antwort.
+ * Wirkt sich auf den nächsten Aufruf von start_dns_server() aus.
+ *
+ * @param ip6 16 Bytes in Netzwerk-Byte-Reihenfolge.
+ */
+void dns_server_set_ip6(const uint8_t *ip6);
+
+/**
+ * @brief Beantwortet alle Namen außer den bekannten Konnektivitäts-Check-Domains mit NXDOMAIN.
+ *
+ * Hält Hintergrund-Anfragen von Apps vom Webserver fern. Wirkt sich auf den nächsten Aufruf von
+ * start_dns_server() aus.
+ */
+void dns_server_set_nxdomain_unknown(bool enable);
+
+/**
+ * @brief Liefert die Zähler des laufenden (oder zuletzt gelaufenen) Servers.
+ */
+void dns_server_get_stats(dns_server_stats_t *stats);
@@ -0,0 +1,370 @@
+#include "form_parser.hpp"
+
+// Namen der Felder in der Reihenfolge von field_id_t
+static const char *const s_field_names[] = { "ssid", "password", "timezone" };
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool is_json_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Zeichen, aus denen Zahlen, true, false und null bestehen
+static bool is_json_scalar(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+void FormParser::reset(form_format_t format) {
+    _format = format;
+    _error = false;
+    _error_field = "";
+
+    _fields[FIELD_SSID] = { _ssid, FORM_SSID_MAX_LEN, 0, false, false };
+    _fields[FIELD_PASSWORD] = { _password, FORM_PASSWORD_MAX_LEN, 0, false, false };
+    _fields[FIELD_TIMEZONE] = { _timezone, FORM_TIMEZONE_MAX_LEN, 0, false, false };
+    for (Field& field : _fields) field.buf[0] = '\0';
+
+    _key_len = 0;
+    // Ein urlencoded Body beginnt mit einem Schlüssel, ein JSON-Body mit '{'
+    _in_key = format == FORM_FORMAT_URLENCODED;
+    _field = FIELD_NONE;
+    _pct_digits = 0;
+    _pct_value = 0;
+    _json_state = JSON_START;
+    _escape = 0;
+    _unicode = 0;
+    _high_surrogate = 0;
+}
+
+bool FormParser::feed(const char *data, size_t len) {
+    if (_error) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        bool ok = _format == FORM_FORMAT_JSON ? feed_json(data[i]) : feed_urlencoded(data[i]);
+        if (!ok) {
+            _error = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+void FormParser::begin_key() {
+    _in_key = true;
+    _key_len = 0;
+    _field = FIELD_NONE;
+}
+
+/**
+ * @brief Beendet den Schlüssel; die folgenden Zeichen gehen in das passende Feld oder werden verworfen.
+ * Ein wiederholter Schlüssel beginnt das Feld neu (der letzte Wert gilt).
+ */
+void FormParser::select_field() {
+    _in_key = false;
+    _field = FIELD_NONE;
+    if (_key_len > KEY_CAPACITY) {
+        return;
+    }
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        const char *name = s_field_names[i];
+        size_t n = 0;
+        while (n < _key_len && name[n] == _key[n]) n++;
+        if (n == _key_len && name[n] == '\0') {
+            Field& field = _fields[i];
+            field.len = 0;
+            field.seen = true;
+            field.overflow = false;
+            _field = i;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Schreibt ein dekodiertes Zeichen in den Schlüssel oder das aktuelle Feld.
+ * Überlange Werte werden nur markiert, damit finish() sie ablehnt, statt sie abzuschneiden.
+ */
+bool FormParser::put(char c) {
+    if (c == '\0') {
+        return false;  // Die Felder sind C-Strings
+    }
+    if (_in_key) {
+        if (_key_len < KEY_CAPACITY) {
+            _key[_key_len++] = c;
+        } else {
+            _key_len = KEY_CAPACITY + 1;
+        }
+        return true;
+    }
+    if (_field == FIELD_NONE) {
+        return true;
+    }
+    Field& field = _fields[_field];
+    if (field.len < field.capacity) {
+        field.buf[field.len++] = c;
+    } else {
+        field.overflow = true;
+    }
+    return true;
+}
+
+bool FormParser::feed_urlencoded(char c) {
+    // Prozent-Kodierung; die beiden Hex-Ziffern können im nächsten Stück folgen
+    if (_pct_digits > 0) {
+        int value = hex_value(c);
+        if (value < 0) {
+            return false;
+        }
+        _pct_value = (_pct_value << 4) | value;
+        if (_pct_digits == 2) {
+            _pct_digits = 0;
+            return put((char)_pct_value);
+        }
+        _pct_digits = 2;
+        return true;
+    }
+
+    switch (c) {
+    case '%':
+        _pct_digits = 1;
+        _pct_value = 0;
+        return true;
+    case '+':
+        return put(' ');
+    case '&':
+        // Ein Schlüssel ohne '=' zählt als leerer Wert
+        if (_in_key && _key_len > 0) select_field();
+        begin_key();
+        return true;
+    case '=':
+        if (_in_key) {
+            select_field();
+            return true;
+        }
+        return put(c);
+    default:
+        return put(c);
+    }
+}
+
+bool FormParser::feed_json(char c) {
+    switch (_json_state) {
+    case JSON_START:
+        if (is_json_space(c)) return true;
+        if (c != '{') return false;
+        _json_state = JSON_FIRST_KEY;
+        return true;
+
+    case JSON_FIRST_KEY:
+    case JSON_KEY:
+        if (is_json_space(c)) return true;
+        if (c == '}' && _json_state == JSON_FIRST_KEY) {
+            _json_state = JSON_END;
+            return true;
+        }
+        if (c != '"') return false;
+        begin_key();
+        _json_state = JSON_IN_KEY;
+        return true;
+
+    case JSON_IN_KEY:
+    case JSON_IN_STRING:
+        if (_escape == 0 && c == '"') {
+            if (_high_surrogate != 0) return false;
+            if (_json_state == JSON_IN_KEY) {
+                _json_state = JSON_COLON;
+            } else {
+                _field = FIELD_NONE;
+                _json_state = JSON_AFTER_VALUE;
+            }
+            return true;
+        }
+        return json_string_char(c);
+
+    case JSON_COLON:
+        if (is_json_space(c)) return true;
+        if (c != ':') return false;
+        select_field();
+        _json_state = JSON_VALUE;
+        return true;
+
+    case JSON_VALUE:
+        if (is_json_space(c)) return true;
+        if (c == '"') {
+            _json_state = JSON_IN_STRING;
+            return true;
+        }
+        // Die bekannten Felder sind Strings; bei unbekannten Schlüsseln werden Zahlen und Literale
+        // übersprungen, Objekte und Arrays aber nicht unterstützt
+        if (_field != FIELD_NONE || !is_json_scalar(c)) return false;
+        _json_state = JSON_IN_SCALAR;
+        return true;
+
+    case JSON_IN_SCALAR:
+        if (is_json_scalar(c)) return true;
+        _json_state = JSON_AFTER_VALUE;
+        return feed_json(c);
+
+    case JSON_AFTER_VALUE:
+        if (is_json_space(c)) return true;
+        if (c == ',') {
+            _json_state = JSON_KEY;
+            return true;
+        }
+        if (c != '}') return false;
+        _json_state = JSON_END;
+        return true;
+
+    case JSON_END:
+        return is_json_space(c);
+    }
+    return false;
+}
+
+/**
+ * @brief Ein Zeichen innerhalb eines JSON-Strings (Schlüssel oder Wert), einschließlich Escapes.
+ */
+bool FormParser::json_string_char(char c) {
+    if (_escape == 0) {
+        if (c == '\\') {
+            _escape = 1;
+            return true;
+        }
+        // Steuerzeichen müssen kodiert sein; auf ein High Surrogate muss ein \u mit Low Surrogate folgen
+        if ((unsigned char)c < 0x20 || _high_surrogate != 0) return false;
+        return put(c);
+    }
+
+    if (_escape == 1) {
+        _escape = 0;
+        if (c == 'u') {
+            _escape = 2;
+            _unicode = 0;
+            return true;
+        }
+        if (_high_surrogate != 0) return false;
+        switch (c) {
+        case '"':
+        case '\\':
+        case '/': return put(c);
+        case 'b': return put('\b');
+        case 'f': return put('\f');
+        case 'n': return put('\n');
+        case 'r': return put('\r');
+        case 't': return put('\t');
+        default: return false;
+        }
+    }
+
+    // \uXXXX: vier Hex-Ziffern, ggf. über zwei Stücke verteilt
+    int value = hex_value(c);
+    if (value < 0) {
+        return false;
+    }
+    _unicode = (_unicode << 4) | value;
+    if (++_escape < 6) {
+        return true;
+    }
+    _escape = 0;
+    return json_codepoint(_unicode);
+}
+
+/**
+ * @brief Schreibt ein Unicode-Zeichen aus einer \\u-Sequenz als UTF-8; fügt Surrogate-Paare zusammen.
+ */
+bool FormParser::json_codepoint(uint32_t codepoint) {
+    if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+        if (_high_surrogate != 0) return false;
+        _high_surrogate = codepoint;
+        return true;
+    }
+    if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+        if (_high_surrogate == 0) return false;
+        codepoint = 0x10000 + ((_high_surrogate - 0xD800) << 10) + (codepoint - 0xDC00);
+        _high_surrogate = 0;
+    } else if (_high_surrogate != 0) {
+        return false;
+    }
+
+    if (codepoint < 0x80) {
+        return put((char)codepoint);
+    }
+    if (codepoint < 0x800) {
+        return put((char)(0xC0 | (codepoint >> 6))) && put((char)(0x80 | (codepoint & 0x3F)));
+    }
+    if (codepoint < 0x10000) {
+        return put((char)(0xE0 | (codepoint >> 12))) && put((char)(0x80 | ((codepoint >> 6) & 0x3F))) &&
+               put((char)(0x80 | (codepoint & 0x3F)));
+    }
+    return put((char)(0xF0 | (codepoint >> 18))) && put((char)(0x80 | ((codepoint >> 12) & 0x3F))) &&
+           put((char)(0x80 | ((codepoint >> 6) & 0x3F))) && put((char)(0x80 | (codepoint & 0x3F)));
+}
+
+form_result_t FormParser::finish() {
+    if (!_error) {
+        if (_format == FORM_FORMAT_JSON) {
+            _error = _json_state != JSON_END;
+        } else {
+            _error = _pct_digits != 0;
+            if (_in_key && _key_len > 0) select_field();
+        }
+    }
+    _error_field = "";
+    if (_error) {
+        return FORM_ERR_SYNTAX;
+    }
+
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        Field& field = _fields[i];
+        field.buf[field.len] = '\0';
+        if (field.overflow) {
+            _error_field = s_field_names[i];
+            return FORM_ERR_TOO_LONG;
+        }
+    }
+
+    if (_fields[FIELD_SSID].len == 0 || _fields[FIELD_TIMEZONE].len == 0) {
+        _error_field = s_field_names[_fields[FIELD_SSID].len == 0 ? FIELD_SSID : FIELD_TIMEZONE];
+        return FORM_ERR_MISSING;
+    }
+
+    // Leer (offenes Netz), Passphrase aus 8-63 Bytes oder PSK aus 64 Hex-Ziffern. IEEE 802.11 erlaubt
+    // in der Passphrase nur druckbares ASCII (0x20-0x7E); Bytes ab 0x80 werden bewusst trotzdem
+    // angenommen, weil manche Router UTF-8-Passphrasen zulassen und PBKDF2 die rohen Bytes verarbeitet.
+    // Steuerzeichen (< 0x20, 0x7F) bleiben abgelehnt, damit z.B. ein mitkopierter Tabulator oder
+    // Zeilenumbruch nicht unbemerkt Teil des gespeicherten Passworts wird.
+    size_t len = _fields[FIELD_PASSWORD].len;
+    bool valid = len == 0;
+    if (len == FORM_PASSWORD_MAX_LEN) {
+        valid = true;
+        for (size_t i = 0; i < len; i++) valid = valid && hex_value(_password[i]) >= 0;
+    } else if (len >= FORM_PASSPHRASE_MIN_LEN && len <= FORM_PASSPHRASE_MAX_LEN) {
+        valid = true;
+        for (size_t i = 0; i < len; i++) {
+            unsigned char c = (unsigned char)_password[i];
+            valid = valid && c >= 0x20 && c != 0x7F;
+        }
+    }
+    if (!valid) {
+        _error_field = s_field_names[FIELD_PASSWORD];
+        return FORM_ERR_PASSWORD;
+    }
+    return FORM_OK;
+}
+
+const char *FormParser::result_name(form_result_t result) {
+    switch (result) {
+    case FORM_OK: return "ok";
+    case FORM_ERR_SYNTAX: return "syntax error";
+    case FORM_ERR_TOO_LONG: return "value too long";
+    case FORM_ERR_MISSING: return "missing field";
+    case FORM_ERR_PASSWORD: return "invalid password";
+    }
+    return "unknown";
+}
@@ -0,0 +1,147 @@
+/**
+ * @file form_parser.hpp
+ * @brief Streaming-Parser für den Body von POST /save.
+ *
+ * Der Body wird in beliebig großen Stücken übergeben, so wie httpd_req_recv() ihn liefert. Jedes Byte
+ * wird genau einmal betrachtet und direkt dekodiert in den endgültigen Puffer des Feldes geschrieben;
+ * es gibt weder eine Kopie des ganzen Bodys noch Heap-Speicher. Ein Prozentzeichen oder eine
+ * \\u-Escape-Sequenz darf dabei auf zwei Stücke verteilt sein.
+ *
+ * Unterstützte Formate:
+ * - application/x-www-form-urlencoded: `ssid=...&password=...&timezone=...` (Standard des Formulars)
+ * - application/json: ein flaches Objekt `{"ssid":"...","password":"...","timezone":"..."}`;
+ *   unbekannte Schlüssel mit Zahlen, true/false/null oder Strings werden übersprungen, verschachtelte
+ *   Objekte und Arrays abgelehnt.
+ *
+ * Ein zu langer Wert wird nicht abgeschnitten, sondern als Fehler gemeldet. finish() prüft zusätzlich
+ * die Regeln von WPA: SSID 1-32 Bytes, Passwort leer (offenes Netz), 8-63 Bytes ohne Steuerzeichen
+ * (Passphrase; abweichend von IEEE 802.11 auch UTF-8, siehe finish()) oder genau 64 Hex-Ziffern (PSK). Wie die DNS-Engine kennt der Parser weder lwIP noch
+ * FreeRTOS und läuft auch im Host-Benchmark.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Maximale Längen der Felder (ohne Nullterminierung)
+#define FORM_SSID_MAX_LEN 32
+#define FORM_PASSWORD_MAX_LEN 64
+#define FORM_TIMEZONE_MAX_LEN 63
+
+// Längen einer WPA-Passphrase; 64 Zeichen sind nur als Hex-PSK gültig
+#define FORM_PASSPHRASE_MIN_LEN 8
+#define FORM_PASSPHRASE_MAX_LEN 63
+
+enum form_format_t {
+    FORM_FORMAT_URLENCODED,
+    FORM_FORMAT_JSON,
+};
+
+enum form_result_t {
+    FORM_OK,
+    FORM_ERR_SYNTAX,    // Ungültige Prozent- oder JSON-Kodierung, Nullbyte im Wert
+    FORM_ERR_TOO_LONG,  // Ein Wert passt nicht in seinen Puffer
+    FORM_ERR_MISSING,   // SSID oder Zeitzone fehlt oder ist leer
+    FORM_ERR_PASSWORD,  // Passwort hat eine ungültige Länge, enthält Steuerzeichen oder 64 Zeichen, die nicht hex sind
+};
+
+class FormParser {
+public:
+    explicit FormParser(form_format_t format = FORM_FORMAT_URLENCODED) { reset(format); }
+    // Die Felder zeigen auf die eigenen Puffer
+    FormParser(const FormParser&) = delete;
+    FormParser& operator=(const FormParser&) = delete;
+
+    /**
+     * @brief Setzt alle Felder zurück und legt das Format des nächsten Bodys fest.
+     */
+    void reset(form_format_t format);
+
+    /**
+     * @brief Verarbeitet das nächste Stück des Bodys.
+     * @return false, sobald ein Syntaxfehler erkannt wurde (weitere Daten müssen nicht gelesen werden).
+     */
+    bool feed(const char *data, size_t len);
+
+    /**
+     * @brief Schließt den Body ab und prüft die Felder.
+     * @return FORM_OK, wenn SSID, Passwort und Zeitzone verwendet werden können.
+     */
+    form_result_t finish();
+
+    // Nullterminierte Werte; erst nach finish() == FORM_OK vollständig geprüft
+    const char *ssid() const { return _ssid; }
+    const char *password() const { return _password; }
+    const char *timezone() const { return _timezone; }
+    size_t ssid_len() const { return _fields[FIELD_SSID].len; }
+    size_t password_len() const { return _fields[FIELD_PASSWORD].len; }
+    size_t timezone_len() const { return _fields[FIELD_TIMEZONE].len; }
+
+    /**
+     * @brief Name des Feldes, an dem finish() gescheitert ist ("" bei Syntaxfehlern und FORM_OK).
+     */
+    const char *error_field() const { return _error_field; }
+
+    static const char *result_name(form_result_t result);
+
+private:
+    enum field_id_t { FIELD_SSID, FIELD_PASSWORD, FIELD_TIMEZONE, FIELD_COUNT, FIELD_NONE = FIELD_COUNT };
+
+    struct Field {
+        char *buf;
+        size_t capacity;  // ohne Nullterminierung
+        size_t len;
+        bool seen;
+        bool overflow;
+    };
+
+    // Zustände des JSON-Automaten
+    enum json_state_t {
+        JSON_START,          // vor '{'
+        JSON_FIRST_KEY,      // nach '{': Schlüssel oder '}'
+        JSON_KEY,            // nach ',': Schlüssel
+        JSON_IN_KEY,
+        JSON_COLON,
+        JSON_VALUE,
+        JSON_IN_STRING,
+        JSON_IN_SCALAR,      // Zahl, true, false oder null eines unbekannten Schlüssels
+        JSON_AFTER_VALUE,    // ',' oder '}'
+        JSON_END,            // nach '}': nur noch Leerraum
+    };
+
+    // Länge des Schlüssel-Puffers; längere Schlüssel sind unbekannt
+    static constexpr size_t KEY_CAPACITY = 15;
+
+    bool feed_urlencoded(char c);
+    bool feed_json(char c);
+    bool json_string_char(char c);
+    bool json_codepoint(uint32_t codepoint);
+
+    void begin_key();
+    void select_field();
+    bool put(char c);
+
+    form_format_t _format;
+    bool _error;
+    const char *_error_field;
+
+    char _ssid[FORM_SSID_MAX_LEN + 1];
+    char _password[FORM_PASSWORD_MAX_LEN + 1];
+    char _timezone[FORM_TIMEZONE_MAX_LEN + 1];
+    Field _fields[FIELD_COUNT];
+
+    char _key[KEY_CAPACITY + 1];
+    size_t _key_len;
+    bool _in_key;          // Zeichen gehen in _key statt in das aktuelle Feld
+    int _field;            // Aktuelles Feld oder FIELD_NONE (Wert wird verworfen)
+
+    // urlencoded: gelesene Hex-Ziffern nach '%' (0 = keine Escape-Sequenz offen)
+    uint8_t _pct_digits;
+    uint8_t _pct_value;
+
+    // JSON
+    json_state_t _json_state;
+    uint8_t _escape;       // 0 = normal, 1 = nach '\\', 2-5 = Hex-Ziffern von \\uXXXX
+    uint32_t _unicode;
+    uint32_t _high_surrogate;
+};
@@ -0,0 +1,280 @@
+/**
+ * @file dns_bench.cpp
+ * @brief Host-Benchmark für die Captive-DNS-Engine.
+ *
+ * Spielt Anfrage-Bursts durch `DnsEngine::handle_query()` und gibt den Durchsatz (Queries/s) sowie
+ * p50/p99 der Kosten pro Anfrage aus.
+ *
+ * Ohne Argument wird ein synthetischer Burst verwendet, der das Verhalten von 20 gleichzeitig
+ * verbundenen Telefonen nachbildet (Konnektivitäts-Checks, A/AAAA/HTTPS, teils mit EDNS).
+ * Alternativ kann ein Mitschnitt übergeben werden: eine Datei mit einem UDP-Payload pro Zeile
+ * als Hex-String, z.B. erzeugt mit
+ *
+ *   tshark -r capture.pcap -Y "udp.dstport == 53" -T fields -e udp.payload > capture.hex
+ *
+ * Anschließend wird der Token-Bucket pro Client (dns_rate_limiter.hpp) mit einer Flut geprüft: Die
+ * Telefone senden ihren Burst, ein weiterer Client fragt eine Sekunde lang jede Millisekunde. Ausgegeben
+ * werden die durchgelassenen Anfragen je Gruppe und die Kosten einer verworfenen Anfrage.
+ *
+ * Aufruf: dns_bench [capture.hex|-] [runden] [nxdomain]
+ */
+
+#include "dns_engine.hpp"
+#include "dns_rate_limiter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using Packet = std::vector<uint8_t>;
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint16_t QTYPE_A = 1;
+static constexpr uint16_t QTYPE_AAAA = 28;
+static constexpr uint16_t QTYPE_HTTPS = 65;
+
+static constexpr int SIM_PHONES = 20;
+
+struct Probe {
+    const char *name;
+    uint16_t qtype;
+};
+
+// Typische Anfragen direkt nach der Assoziierung, je Betriebssystem-Familie
+static const Probe ios_burst[] = {
+    {"captive.apple.com", QTYPE_A}, {"captive.apple.com", QTYPE_AAAA}, {"captive.apple.com", QTYPE_HTTPS},
+    {"gsp64-ssl.ls.apple.com", QTYPE_A}, {"gsp64-ssl.ls.apple.com", QTYPE_AAAA},
+    {"time.apple.com", QTYPE_A}, {"mask.icloud.com", QTYPE_HTTPS}, {"www.apple.com", QTYPE_A},
+    {"init.itunes.apple.com", QTYPE_A}, {"api.smoot.apple.com", QTYPE_AAAA},
+};
+static const Probe android_burst[] = {
+    {"connectivitycheck.gstatic.com", QTYPE_A}, {"connectivitycheck.gstatic.com", QTYPE_AAAA},
+    {"www.google.com", QTYPE_A}, {"www.google.com", QTYPE_AAAA}, {"clients3.google.com", QTYPE_A},
+    {"mtalk.google.com", QTYPE_A}, {"play.googleapis.com", QTYPE_A}, {"time.android.com", QTYPE_A},
+    {"android.clients.google.com", QTYPE_A}, {"dns.google", QTYPE_HTTPS}, {"graph.facebook.com", QTYPE_A},
+};
+static const Probe windows_burst[] = {
+    {"www.msftconnecttest.com", QTYPE_A}, {"ipv6.msftconnecttest.com", QTYPE_AAAA},
+    {"dns.msftncsi.com", QTYPE_A}, {"login.live.com", QTYPE_A}, {"settings-win.data.microsoft.com", QTYPE_A},
+    {"detectportal.firefox.com", QTYPE_A}, {"detectportal.firefox.com", QTYPE_AAAA},
+};
+
+/**
+ * @brief Baut eine Standard-Anfrage (RD gesetzt) für einen Namen, optional mit EDNS-OPT-Record.
+ */
+static Packet build_query(uint16_t id, const char *name, uint16_t qtype, bool edns) {
+    Packet p = {
+        uint8_t(id >> 8), uint8_t(id), 0x01, 0x00, // ID, Flags (RD)
+        0x00, 0x01, 0x00, 0x00,                    // QDCOUNT = 1, ANCOUNT = 0
+        0x00, 0x00, 0x00, uint8_t(edns ? 1 : 0),   // NSCOUNT = 0, ARCOUNT
+    };
+    const char *label = name;
+    while (*label) {
+        const char *dot = strchr(label, '.');
+        size_t len = dot ? size_t(dot - label) : strlen(label);
+        p.push_back(uint8_t(len));
+        p.insert(p.end(), label, label + len);
+        label += len + (dot ? 1 : 0);
+    }
+    p.push_back(0);
+    p.push_back(uint8_t(qtype >> 8)); p.push_back(uint8_t(qtype));
+    p.push_back(0x00); p.push_back(0x01); // QCLASS IN
+
+    if (edns) {
+        // OPT-Record: Root-Name, TYPE 41, UDP-Payload 1232, keine Optionen
+        const uint8_t opt[] = {0x00, 0x00, 0x29, 0x04, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        p.insert(p.end(), opt, opt + sizeof(opt));
+    }
+    return p;
+}
+
+/**
+ * @brief Erzeugt einen synthetischen Burst von SIM_PHONES Geräten mit gemischten Betriebssystemen.
+ * Die Anfragen der Geräte werden verschränkt, wie sie auch am Socket ankommen würden.
+ */
+static std::vector<Packet> synthetic_burst() {
+    std::mt19937 rng(42);
+    std::vector<std::vector<Packet>> per_phone(SIM_PHONES);
+
+    for (int phone = 0; phone < SIM_PHONES; phone++) {
+        const Probe *burst;
+        size_t count;
+        bool edns;
+        switch (phone % 3) {
+            case 0:  burst = ios_burst;     count = std::size(ios_burst);     edns = true;  break;
+            case 1:  burst = android_burst; count = std::size(android_burst); edns = false; break;
+            default: burst = windows_burst; count = std::size(windows_burst); edns = true;  break;
+        }
+        for (size_t i = 0; i < count; i++) {
+            per_phone[phone].push_back(build_query(uint16_t(rng()), burst[i].name, burst[i].qtype, edns));
+        }
+    }
+
+    std::vector<Packet> burst;
+    for (size_t i = 0; ; i++) {
+        bool any = false;
+        for (auto& phone : per_phone) {
+            if (i < phone.size()) {
+                burst.push_back(phone[i]);
+                any = true;
+            }
+        }
+        if (!any) break;
+    }
+    return burst;
+}
+
+/**
+ * @brief Liest einen Mitschnitt: ein Hex-kodierter UDP-Payload pro Zeile, ':' und Leerzeichen erlaubt.
+ */
+static std::vector<Packet> load_capture(const char *path) {
+    std::vector<Packet> packets;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        Packet p;
+        int high = -1;
+        for (char c : line) {
+            int v;
+            if (c >= '0' && c <= '9') v = c - '0';
+            else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+            else continue;
+            if (high < 0) { high = v; } else { p.push_back(uint8_t(high << 4 | v)); high = -1; }
+        }
+        if (!p.empty() && p.size() <= DNS_MAX_LEN) packets.push_back(std::move(p));
+    }
+    return packets;
+}
+
+// Flut-Szenario: Dauer und Abstand der Anfragen des fluteten Clients
+static constexpr uint32_t FLOOD_DURATION_MS = 1000;
+static constexpr uint32_t PHONE_BURST_SPREAD_MS = 100;
+
+struct TimedQuery {
+    uint32_t t_ms;
+    uint32_t ip;
+    const Packet *packet;
+};
+
+/**
+ * @brief Spielt den Burst der Telefone (je eine eigene IP, verteilt auf die ersten 100 ms) zusammen mit
+ * einem Client ab, der 1000 Anfragen pro Sekunde sendet, und gibt die durchgelassenen Anfragen aus.
+ */
+static void run_flood(const std::vector<Packet>& burst, DnsEngine& engine) {
+    const uint32_t flooder_ip = 0xFE04A8C0; // 192.168.4.254
+    std::vector<TimedQuery> timeline;
+    for (size_t i = 0; i < burst.size(); i++) {
+        uint32_t phone = uint32_t(i % SIM_PHONES);
+        timeline.push_back({uint32_t(i * PHONE_BURST_SPREAD_MS / burst.size()), 0x0A04A8C0 + (phone << 24), &burst[i]});
+    }
+    for (uint32_t t = 0; t < FLOOD_DURATION_MS; t++) {
+        timeline.push_back({t, flooder_ip, &burst[0]});
+    }
+    std::stable_sort(timeline.begin(), timeline.end(),
+                     [](const TimedQuery& a, const TimedQuery& b) { return a.t_ms < b.t_ms; });
+
+    DnsRateLimiter limiter;
+    uint8_t buffer[DNS_MAX_LEN];
+    size_t phone_total = 0, phone_allowed = 0, flood_total = 0, flood_allowed = 0, checksum = 0;
+    for (const TimedQuery& q : timeline) {
+        bool allowed = limiter.allow(q.ip, q.t_ms);
+        if (q.ip == flooder_ip) {
+            flood_total++;
+            flood_allowed += allowed;
+        } else {
+            phone_total++;
+            phone_allowed += allowed;
+        }
+        if (allowed) {
+            memcpy(buffer, q.packet->data(), q.packet->size());
+            checksum += engine.handle_query(buffer, q.packet->size(), sizeof(buffer));
+        }
+    }
+
+    // Kosten einer verworfenen Anfrage: der Eimer des Flooders ist leer, die Zeit steht still
+    const long drop_rounds = 1000000;
+    size_t dropped = 0;
+    auto start = Clock::now();
+    for (long i = 0; i < drop_rounds; i++) {
+        dropped += !limiter.allow(flooder_ip, FLOOD_DURATION_MS);
+    }
+    double drop_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / drop_rounds;
+
+    printf("rate limit:   %d q/s, burst %d, %d clients tracked\n",
+           DNS_RATE_LIMIT_QPS, DNS_RATE_LIMIT_BURST, DNS_RATE_LIMIT_CLIENTS);
+    printf("  phones:     %zu / %zu allowed\n", phone_allowed, phone_total);
+    printf("  flooder:    %zu / %zu allowed in %u ms\n", flood_allowed, flood_total, (unsigned)FLOOD_DURATION_MS);
+    printf("  drop cost:  %.1f ns per query (%zu dropped, checksum %zu)\n", drop_ns, dropped, checksum);
+}
+
+static double percentile(std::vector<double>& sorted, double q) {
+    size_t idx = std::min(sorted.size() - 1, size_t(q * (sorted.size() - 1) + 0.5));
+    return sorted[idx];
+}
+
+int main(int argc, char **argv) {
+    std::vector<Packet> burst = (argc > 1 && strcmp(argv[1], "-") != 0) ? load_capture(argv[1]) : synthetic_burst();
+    long rounds = argc > 2 ? strtol(argv[2], nullptr, 10) : 20000;
+    if (burst.empty() || rounds <= 0) {
+        fprintf(stderr, "No queries to replay.\n");
+        return 1;
+    }
+
+    DnsEngine engine(0x0104A8C0); // 192.168.4.1 in Netzwerk-Byte-Reihenfolge (Little-Endian-Host)
+    engine.set_nxdomain_unknown(argc > 3 && strcmp(argv[3], "nxdomain") == 0);
+    uint8_t buffer[DNS_MAX_LEN];
+    size_t checksum = 0;
+
+    // Die Engine arbeitet in-place; die Anfrage wird daher wie beim recvfrom() in den Puffer kopiert
+    auto replay = [&](const Packet& q) {
+        memcpy(buffer, q.data(), q.size());
+        return engine.handle_query(buffer, q.size(), sizeof(buffer));
+    };
+
+    // Aufwärmen
+    for (const auto& q : burst) checksum += replay(q);
+    engine.reset_stats();
+
+    // 1. Durchsatz: ganze Bursts ohne Messung pro Anfrage
+    auto start = Clock::now();
+    for (long r = 0; r < rounds; r++) {
+        for (const auto& q : burst) {
+            checksum += replay(q);
+        }
+    }
+    double elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+    DnsEngine::Stats stats = engine.stats();
+
+    // 2. Latenz: jede Anfrage einzeln messen (enthält den Overhead der Uhr, ~20 ns)
+    std::vector<double> samples;
+    long latency_rounds = std::max(1L, std::min(rounds, 2000L));
+    samples.reserve(size_t(latency_rounds) * burst.size());
+    for (long r = 0; r < latency_rounds; r++) {
+        for (const auto& q : burst) {
+            auto t0 = Clock::now();
+            checksum += replay(q);
+            samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+
+    printf("burst:        %zu queries (%s)\n", burst.size(), argc > 1 && strcmp(argv[1], "-") != 0 ? argv[1] : "synthetic, 20 phones");
+    printf("rounds:       %ld\n", rounds);
+    printf("answered:     %u / %u (nodata %u, errors %u, ignored %u)\n",
+           stats.answered, stats.queries, stats.nodata, stats.errors, stats.ignored);
+    printf("probe table:  %u hits, %u nxdomain\n", stats.probe_hits, stats.nxdomain);
+    printf("throughput:   %.0f queries/s\n", stats.queries / elapsed_s);
+    printf("per query:    p50 %.1f ns, p99 %.1f ns, max %.1f ns\n",
+           percentile(samples, 0.50), percentile(samples, 0.99), samples.back());
+    printf("checksum:     %zu\n", checksum);
+
+    run_flood(burst, engine);
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file form_bench.cpp
+ * @brief Host-Test und -Benchmark für den Streaming-Parser von POST /save (form_parser.cpp).
+ *
+ * Prüft zuerst eine Reihe von Bodys (urlencoded und JSON, gültige und fehlerhafte), jeden in
+ * Stücken von 1, 2, 3, 7 Bytes und am Stück, damit Prozent- und \u-Sequenzen auch über Stückgrenzen
+ * hinweg dekodiert werden. Anschließend wird der längste realistische Body (63-stellige Passphrase,
+ * vollständig kodiert) wiederholt in Stücken von 128 Bytes geparst und die Zeit pro Body ausgegeben.
+ *
+ * Aufruf: form_bench [runden]
+ * Rückgabewert: 1, wenn ein Testfall fehlschlägt.
+ */
+
+#include "form_parser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+struct Case {
+    const char *name;
+    form_format_t format;
+    std::string body;
+    form_result_t result;
+    // Erwartete Werte bei FORM_OK
+    std::string ssid = "";
+    std::string password = "";
+    std::string timezone = "";
+};
+
+static const size_t s_chunk_sizes[] = { 1, 2, 3, 7, SIZE_MAX };
+
+// Kodiert jedes Byte als %XX, wie es ein Browser für Sonderzeichen tut
+static std::string percent_encode_all(const std::string& value) {
+    std::string out;
+    char hex[4];
+    for (unsigned char c : value) {
+        snprintf(hex, sizeof(hex), "%%%02X", c);
+        out += hex;
+    }
+    return out;
+}
+
+static std::string json_escape_all(const std::string& value) {
+    std::string out;
+    char hex[8];
+    for (unsigned char c : value) {
+        snprintf(hex, sizeof(hex), "\\u%04x", c);
+        out += hex;
+    }
+    return out;
+}
+
+static form_result_t parse(FormParser& parser, const Case& c, size_t chunk) {
+    parser.reset(c.format);
+    for (size_t pos = 0; pos < c.body.size(); pos += chunk) {
+        size_t n = std::min(chunk, c.body.size() - pos);
+        if (!parser.feed(c.body.data() + pos, n)) break;
+    }
+    return parser.finish();
+}
+
+static bool run_cases() {
+    // Passphrase mit allen druckbaren Sonderzeichen, 63 Zeichen lang
+    const std::string passphrase = "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~ abcXYZ0123456789abcdefghijklmn";
+    const std::string psk(64, 'a');
+    const std::string ssid32(32, 'S');
+    const std::string tz = "CET-1CEST,M3.5.0,M10.5.0/3";
+    const std::string form_tail = "&timezone=" + percent_encode_all(tz);
+
+    const Case cases[] = {
+        { "form basic", FORM_FORMAT_URLENCODED, "ssid=Home&password=secret123&timezone=UTC0",
+          FORM_OK, "Home", "secret123", "UTC0" },
+        { "form plus and order", FORM_FORMAT_URLENCODED, "timezone=UTC0&ssid=My+Net%21&password=",
+          FORM_OK, "My Net!", "", "UTC0" },
+        { "form 63-char passphrase encoded", FORM_FORMAT_URLENCODED,
+          "ssid=Home&password=" + percent_encode_all(passphrase) + form_tail, FORM_OK, "Home", passphrase, tz },
+        { "form 64-hex psk", FORM_FORMAT_URLENCODED, "ssid=Home&password=" + psk + form_tail,
+          FORM_OK, "Home", psk, tz },
+        { "form 32-byte ssid", FORM_FORMAT_URLENCODED, "ssid=" + ssid32 + form_tail, FORM_OK, ssid32, "", tz },
+        { "form duplicate key", FORM_FORMAT_URLENCODED, "ssid=Old&ssid=New&password&timezone=UTC0&x=1",
+          FORM_OK, "New", "", "UTC0" },
+        { "form 33-byte ssid", FORM_FORMAT_URLENCODED, "ssid=" + ssid32 + "X" + form_tail, FORM_ERR_TOO_LONG },
+        { "form 64 non-hex", FORM_FORMAT_URLENCODED, "ssid=Home&password=" + std::string(64, 'g') + form_tail,
+          FORM_ERR_PASSWORD },
+        { "form 65-char password", FORM_FORMAT_URLENCODED, "ssid=Home&password=" + std::string(65, 'a') + form_tail,
+          FORM_ERR_TOO_LONG },
+        { "form 7-char password", FORM_FORMAT_URLENCODED, "ssid=Home&password=1234567" + form_tail,
+          FORM_ERR_PASSWORD },
+        { "form utf-8 passphrase", FORM_FORMAT_URLENCODED, "ssid=Home&password=Gr%C3%BC%C3%9Fe+123" + form_tail,
+          FORM_OK, "Home", "Gr\xc3\xbc\xc3\x9f" "e 123", tz },
+        { "form 7-byte utf-8", FORM_FORMAT_URLENCODED, "ssid=Home&password=%C3%BC%C3%BC%C3%BCx" + form_tail,
+          FORM_ERR_PASSWORD },
+        { "form pasted tab", FORM_FORMAT_URLENCODED, "ssid=Home&password=secret123%09" + form_tail,
+          FORM_ERR_PASSWORD },
+        { "form pasted newline", FORM_FORMAT_URLENCODED, "ssid=Home&password=secret123%0D%0A" + form_tail,
+          FORM_ERR_PASSWORD },
+        { "form DEL byte", FORM_FORMAT_URLENCODED, "ssid=Home&password=secret%7F123" + form_tail,
+          FORM_ERR_PASSWORD },
+        { "form missing timezone", FORM_FORMAT_URLENCODED, "ssid=Home&password=secret123", FORM_ERR_MISSING },
+        { "form empty ssid", FORM_FORMAT_URLENCODED, "ssid=&timezone=UTC0", FORM_ERR_MISSING },
+        { "form bad percent", FORM_FORMAT_URLENCODED, "ssid=Ho%G1me&timezone=UTC0", FORM_ERR_SYNTAX },
+        { "form truncated percent", FORM_FORMAT_URLENCODED, "timezone=UTC0&ssid=Home%4", FORM_ERR_SYNTAX },
+        { "form null byte", FORM_FORMAT_URLENCODED, "ssid=Ho%00me&timezone=UTC0", FORM_ERR_SYNTAX },
+
+        { "json basic", FORM_FORMAT_JSON,
+          " {\"ssid\" : \"Home\",\n \"password\":\"secret123\", \"timezone\":\"UTC0\"} ",
+          FORM_OK, "Home", "secret123", "UTC0" },
+        { "json escapes", FORM_FORMAT_JSON,
+          "{\"ssid\":\"Caf\\u00e9 \\\"\\ud83d\\ude00\\\"\",\"password\":\"a\\/b\\\\cdefgh\",\"timezone\":\"UTC0\"}",
+          FORM_OK, "Caf\xc3\xa9 \"\xf0\x9f\x98\x80\"", "a/b\\cdefgh", "UTC0" },
+        { "json unknown keys", FORM_FORMAT_JSON,
+          "{\"save\":true,\"ssid\":\"Home\",\"retries\":-1.5e3,\"note\":\"x\",\"timezone\":\"UTC0\",\"v\":null}",
+          FORM_OK, "Home", "", "UTC0" },
+        { "json 63-char passphrase escaped", FORM_FORMAT_JSON,
+          "{\"ssid\":\"Home\",\"password\":\"" + json_escape_all(passphrase) + "\",\"timezone\":\"" + tz + "\"}",
+          FORM_OK, "Home", passphrase, tz },
+        { "json empty object", FORM_FORMAT_JSON, "{}", FORM_ERR_MISSING },
+        { "json number ssid", FORM_FORMAT_JSON, "{\"ssid\":5,\"timezone\":\"UTC0\"}", FORM_ERR_SYNTAX },
+        { "json nested", FORM_FORMAT_JSON, "{\"ssid\":\"a\",\"x\":{\"y\":1},\"timezone\":\"UTC0\"}", FORM_ERR_SYNTAX },
+        { "json trailing comma", FORM_FORMAT_JSON, "{\"ssid\":\"a\",\"timezone\":\"UTC0\",}", FORM_ERR_SYNTAX },
+        { "json unterminated", FORM_FORMAT_JSON, "{\"ssid\":\"a\",\"timezone\":\"UTC0\"", FORM_ERR_SYNTAX },
+        { "json lone surrogate", FORM_FORMAT_JSON, "{\"ssid\":\"\\ud83d\",\"timezone\":\"UTC0\"}", FORM_ERR_SYNTAX },
+        { "json raw newline", FORM_FORMAT_JSON, "{\"ssid\":\"a\nb\",\"timezone\":\"UTC0\"}", FORM_ERR_SYNTAX },
+    };
+
+    FormParser parser;
+    int failures = 0;
+    for (const Case& c : cases) {
+        for (size_t chunk : s_chunk_sizes) {
+            form_result_t result = parse(parser, c, chunk);
+            bool ok = result == c.result;
+            if (ok && result == FORM_OK) {
+                ok = c.ssid == parser.ssid() && c.password == parser.password() && c.timezone == parser.timezone() &&
+                     c.ssid.size() == parser.ssid_len() && c.password.size() == parser.password_len();
+            }
+            if (!ok) {
+                printf("FAIL %-34s chunk %-4zu got '%s' (%s), expected '%s'\n", c.name, chunk == SIZE_MAX ? 0 : chunk,
+                       FormParser::result_name(result), parser.error_field(), FormParser::result_name(c.result));
+                failures++;
+                break;
+            }
+        }
+    }
+    printf("%zu cases x %zu chunk sizes: %s\n", sizeof(cases) / sizeof(cases[0]),
+           sizeof(s_chunk_sizes) / sizeof(s_chunk_sizes[0]), failures == 0 ? "all passed" : "FAILED");
+    return failures == 0;
+}
+
+static void run_bench(const char *name, form_format_t format, const std::string& body, int rounds) {
+    // Wie im Handler: Stücke von 128 Bytes (SAVE_RECV_CHUNK_SIZE)
+    const size_t chunk = 128;
+    FormParser parser;
+    volatile size_t sink = 0;
+    auto start = Clock::now();
+    for (int r = 0; r < rounds; r++) {
+        parser.reset(format);
+        for (size_t pos = 0; pos < body.size(); pos += chunk) {
+            parser.feed(body.data() + pos, std::min(chunk, body.size() - pos));
+        }
+        sink = sink + (parser.finish() == FORM_OK ? parser.password_len() : 0);
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rounds;
+    printf("%-28s %5zu bytes  %8.0f ns/body  %6.1f MB/s  (parser: %zu bytes, no heap)\n", name, body.size(), ns,
+           body.size() / ns * 1000.0, sizeof(FormParser));
+    (void)sink;
+}
+
+int main(int argc, char **argv) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+
+    bool ok = run_cases();
+
+    const std::string passphrase = "p@ss w0rd/with+special&chars=and%percent#signs!!1234567890abcdef";
+    const std::string ssid = "Guest Network 2.4 GHz (Floor 3)";
+    const std::string tz = "CET-1CEST,M3.5.0,M10.5.0/3";
+    std::string form = "ssid=" + percent_encode_all(ssid) + "&password=" + percent_encode_all(passphrase.substr(0, 63)) +
+                       "&timezone=" + percent_encode_all(tz);
+    std::string json = "{\"ssid\":\"" + json_escape_all(ssid) + "\",\"password\":\"" +
+                       json_escape_all(passphrase.substr(0, 63)) + "\",\"timezone\":\"" + json_escape_all(tz) + "\"}";
+    run_bench("urlencoded, all escaped", FORM_FORMAT_URLENCODED, form, rounds);
+    run_bench("json, all \\u-escaped", FORM_FORMAT_JSON, json, rounds);
+    run_bench("urlencoded, typical", FORM_FORMAT_URLENCODED, "ssid=HomeNet&password=correcthorse&timezone=UTC0", rounds);
+
+    return ok ? 0 : 1;
+}
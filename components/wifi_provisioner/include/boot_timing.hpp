@@ -0,0 +1,96 @@
+/**
+ * @file boot_timing.hpp
+ * @brief Zeitstempel der Start- und Verbindungsphasen mit einem Verlauf der letzten Starts im NVS.
+ *
+ * Jede Phase wird beim ersten Erreichen mit der Zeit seit dem Start (esp_timer) festgehalten. Nach der
+ * ersten Verbindung wartet ein Task auf die Zeitsynchronisierung (oder eine Zeitüberschreitung) und
+ * schreibt den Datensatz dann einmal in einen Ringpuffer im NVS. So lassen sich Änderungen an der
+ * Firmware über mehrere Starts hinweg vergleichen (siehe boot_timing_get_summary()).
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+
+// Anzahl der Starts im NVS-Verlauf
+#define BOOT_TIMING_HISTORY_LEN 8
+
+enum boot_phase_t {
+    BOOT_PHASE_NVS_INIT = 0,  // NVS initialisiert (Konstruktor)
+    BOOT_PHASE_WIFI_INIT,     // init_wifi_() abgeschlossen
+    BOOT_PHASE_STA_START,     // WIFI_EVENT_STA_START
+    BOOT_PHASE_ASSOCIATED,    // WIFI_EVENT_STA_CONNECTED
+    BOOT_PHASE_GOT_IP,        // IP_EVENT_STA_GOT_IP
+    BOOT_PHASE_SNTP_SYNC,     // Erste Zeitsynchronisierung
+    BOOT_PHASE_COUNT
+};
+
+// Der Start lief über das Captive Portal; die Zeiten enthalten die Eingabe des Benutzers
+#define BOOT_TIMING_FLAG_PROVISIONING 0x01
+
+struct boot_timing_t {
+    uint32_t phase_ms[BOOT_PHASE_COUNT];  // Millisekunden seit dem Start, 0 = Phase nicht erreicht
+    uint32_t flags;                       // BOOT_TIMING_FLAG_*
+};
+
+struct boot_phase_stats_t {
+    uint32_t min_ms;
+    uint32_t median_ms;
+    uint32_t max_ms;
+    uint8_t samples;  // Anzahl der Starts, in denen die Phase erreicht wurde
+};
+
+struct boot_timing_summary_t {
+    boot_phase_stats_t phases[BOOT_PHASE_COUNT];
+    uint8_t boots;  // Ausgewertete Starts (ohne Starts über das Captive Portal)
+};
+
+/**
+ * @brief Hält den Zeitpunkt einer Phase fest; spätere Aufrufe (z.B. bei Wiederverbindungen) zählen nicht.
+ */
+void boot_timing_mark(boot_phase_t phase);
+
+/**
+ * @brief Setzt Flags (BOOT_TIMING_FLAG_*) für den laufenden Start.
+ */
+void boot_timing_set_flags(uint32_t flags);
+
+/**
+ * @brief Liefert die Zeitstempel des laufenden Starts.
+ */
+const boot_timing_t& boot_timing_current();
+
+/**
+ * @brief Schreibt den laufenden Start in den NVS-Verlauf.
+ *
+ * Der erste Aufruf belegt einen neuen Platz im Ringpuffer (der älteste Eintrag wird überschrieben),
+ * weitere Aufrufe im selben Start aktualisieren diesen Eintrag.
+ * @note Greift auf den Flash zu; nicht aus Callbacks von lwIP, SNTP oder esp_timer aufrufen.
+ */
+esp_err_t boot_timing_save();
+
+/**
+ * @brief Schreibt den laufenden Start einmal aus einem eigenen Task, sobald die letzte Phase
+ * (BOOT_PHASE_SNTP_SYNC) erreicht ist, spätestens nach `timeout_ms`.
+ *
+ * Weitere Aufrufe im selben Start haben keine Wirkung.
+ */
+esp_err_t boot_timing_schedule_save(uint32_t timeout_ms);
+
+/**
+ * @brief Wertet den NVS-Verlauf aus: Minimum, Median und Maximum je Phase.
+ *
+ * Starts über das Captive Portal werden nicht berücksichtigt.
+ */
+esp_err_t boot_timing_get_summary(boot_timing_summary_t *summary);
+
+/**
+ * @brief Gibt den laufenden Start und die Auswertung des Verlaufs im Log aus.
+ */
+void boot_timing_log_summary();
+
+/**
+ * @brief Name einer Phase für Log-Ausgaben.
+ */
+const char *boot_phase_name(boot_phase_t phase);
@@ -48,9 +48,30 @@
  * (NVS, WiFi, Events etc.) auf eine sichere Weise, die nur einmal ausgeführt wird. Die `app_main`-Funktion
  * bleibt dadurch extrem sauber und einfach.
  *
+ * - **Prüfung der Zugangsdaten im Portal:** Nach dem Absenden verbindet sich das Gerät testweise, während
+ * der Access Point weiterläuft (APSTA). Die Seite fragt das Ergebnis über `/status` ab; bei einem falschen
+ * Passwort kann der Benutzer es sofort korrigieren. Gespeichert und beendet wird erst nach erfolgreicher
+ * Verbindung.
+ *
  * - **Blockierender Prozess ohne Neustarts:** Der `start_provisioning()`-Prozess ist "blockierend".
  * Das bedeutet, die `app_main`-Funktion wartet, bis der Benutzer seine Daten eingegeben hat.
  * Danach wird die Verbindung direkt hergestellt, ohne dass ein störender Neustart des Geräts nötig ist.
+ * Soll die Anwendung währenddessen weiterlaufen (Regelschleife, Anzeige, ...), startet
+ * `start_provisioning_async()` das Portal im Hintergrund; das Ergebnis kommt per Callback oder über
+ * `wait_provisioning()`, `cancel_provisioning()` beendet das Portal vorzeitig:
+ *
+ * ```cpp
+ * provisioner.start_provisioning_async("ESP32-Setup", true, "", nullptr, 10 * 60 * 1000);
+ * while (provisioner.wait_provisioning(pdMS_TO_TICKS(100)) == ESP_ERR_TIMEOUT) {
+ *     control_loop_step(); // läuft weiter, während das Portal offen ist
+ * }
+ * ```
+ *
+ * - **Mehrere Netzwerke:** Bis zu `WIFI_PROV_MAX_NETWORKS` Netzwerke werden gespeichert; jede weitere
+ * Einrichtung fügt eines hinzu. Für jedes Netzwerk werden Erfolge, Fehlversuche und die Zeit bis zur
+ * IP-Adresse mitgeführt. Ist das zuletzt verwendete nicht erreichbar, wird gescannt, nach Signalstärke und
+ * Verlauf sortiert und der Reihe nach verbunden, ohne Neustart. So wechselt ein Gerät zwischen bekannten
+ * Standorten, ohne neu eingerichtet zu werden.
  *
  * - **Optionale dauerhafte Speicherung:** Die `start_provisioning()`-Methode hat ein Flag `persistent_storage`.
  * Ist dieses `true`, werden die Daten im NVS-Flash gespeichert. Ist es `false`, werden die Daten nur
@@ -59,9 +80,12 @@
  *
  * - **Automatische Fehlerbehandlung:** Gibt ein Benutzer ein falsches Passwort ein, würde das Gerät
  * normalerweise in einer Endlosschleife versuchen, sich zu verbinden. Diese Klasse zählt die
- * Fehlversuche. Nach 5 erfolglosen Versuchen löscht sie die fehlerhaften Zugangsdaten aus dem NVS
+ * Authentifizierungsfehler. Nach 5 davon löscht sie die fehlerhaften Zugangsdaten aus dem NVS
  * und startet neu, wodurch das Gerät automatisch wieder im Konfigurationsmodus ist. Es ist für den
- * Benutzer somit unmöglich, das Gerät "versehentlich zu bricken".
+ * Benutzer somit unmöglich, das Gerät "versehentlich zu bricken" (nur mit einem einzigen gespeicherten
+ * Netzwerk; bei mehreren wird stattdessen das nächste versucht). Ist der Router dagegen nur nicht
+ * erreichbar, oder hat mit den Zugangsdaten schon einmal eine Verbindung bestanden, versucht es die
+ * Klasse mit wachsendem Abstand (bis 60 s) unbegrenzt weiter, ohne den Event-Loop zu blockieren.
  *
  * ## Verwendung in der Anwendung (`main.cpp`)
  *
@@ -105,11 +129,44 @@
 
 #pragma once
 #include <string>
+#include <functional>
 #include "esp_err.h"
 #include "esp_http_server.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h" 
+#include "freertos/task.h"
 #include "esp_sntp.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "boot_timing.hpp"
+
+/**
+ * @brief Kapazität des Captive Portals (siehe WifiProvisioner::set_portal_config()).
+ */
+struct wifi_portal_config_t {
+    uint8_t max_clients = 4;        // Gleichzeitig mit dem Access Point verbundene Geräte (1-10)
+    uint16_t max_open_sockets = 0;  // Gleichzeitige HTTP-Verbindungen; 0 = so viele, wie CONFIG_LWIP_MAX_SOCKETS zulässt
+    bool lru_purge_enable = true;   // Bei vollen Sockets die am längsten ungenutzte Verbindung schließen
+    esp_ip4_addr_t ap_ip = { ESP_IP4TOADDR(192, 168, 4, 1) };         // Adresse des Access Points (Gateway, DNS, Portal)
+    esp_ip4_addr_t ap_netmask = { ESP_IP4TOADDR(255, 255, 255, 0) };  // Subnetz, aus dem DHCP Adressen vergibt
+    uint8_t channel = 0;            // Kanal des Access Points; 0 = nach einem Scan den am wenigsten belegten wählen
+    uint16_t beacon_interval = 100; // Beacon-Intervall in TU (1 TU = 1,024 ms, 100-60000)
+    int8_t max_tx_power = 0;        // Sendeleistung in 0,25 dBm (8-84, also 2-21 dBm); 0 = Vorgabe des Treibers
+};
+
+// Anzahl der Netzwerke, die dauerhaft gespeichert werden (siehe WifiProvisioner::get_networks())
+#define WIFI_PROV_MAX_NETWORKS 4
+
+/**
+ * @brief Ein gespeichertes Netzwerk mit seinem Verbindungsverlauf.
+ */
+struct wifi_network_info_t {
+    char ssid[33];
+    uint16_t successes;            // Verbindungen bis zur IP-Adresse
+    uint16_t failures;             // Fehlgeschlagene Verbindungsversuche
+    uint16_t time_to_ip_ms;        // Dauer der letzten erfolgreichen Verbindung
+    uint8_t consecutive_failures;  // Fehlversuche seit der letzten erfolgreichen Verbindung
+};
 
 class WifiProvisioner {
 public:
@@ -129,6 +186,59 @@ public:
      */
     esp_err_t start_provisioning(const std::string& ap_ssid, bool persistent_storage, const std::string& ap_password = "");
 
+    /**
+     * @brief Legt fest, wie viele Geräte und Verbindungen das Captive Portal gleichzeitig bedient.
+     * @note Gilt für den nächsten Aufruf von start_provisioning() bzw. start_provisioning_async().
+     */
+    void set_portal_config(const wifi_portal_config_t& config);
+
+    /**
+     * @brief Wird nach dem Ende der Provisionierung aufgerufen, nachdem AP, DNS- und Webserver beendet sind.
+     * @param result ESP_OK (Zugangsdaten empfangen), ESP_ERR_TIMEOUT oder ESP_FAIL (abgebrochen).
+     */
+    using provisioning_callback_t = std::function<void(esp_err_t result)>;
+
+    /**
+     * @brief Startet den Provisionierungs-Modus, ohne zu blockieren.
+     *
+     * Legt den Provisionierungs-Task an und kehrt sofort zurück; die Anwendung kann währenddessen
+     * weiterlaufen. Der Task wählt den Kanal (Scan von etwa 1-2 s, falls nicht fest vorgegeben) und startet
+     * AP, DNS- und Webserver. Das Ende wird über `on_complete` gemeldet (aus diesem Task) oder mit
+     * wait_provisioning() abgewartet; cancel_provisioning() bricht ab. Scheitert der Start der Dienste,
+     * kommt der Fehler auf demselben Weg.
+     *
+     * @param ap_ssid Der Name des WLAN-Netzwerks, das der ESP32 aufspannt.
+     * @param persistent_storage Wenn true, werden die Daten dauerhaft im NVS gespeichert.
+     * @param ap_password Optionales Passwort für den Access Point.
+     * @param on_complete Optionaler Callback mit dem Ergebnis.
+     * @param timeout_ms Nach dieser Zeit ohne Eingabe wird das Portal beendet (0 = unbegrenzt).
+     * @return esp_err_t ESP_OK, wenn der Task läuft; ESP_ERR_INVALID_STATE, wenn das Portal bereits läuft;
+     * ESP_ERR_NO_MEM, wenn der Task nicht angelegt werden konnte.
+     */
+    esp_err_t start_provisioning_async(const std::string& ap_ssid, bool persistent_storage,
+                                       const std::string& ap_password = "", provisioning_callback_t on_complete = nullptr,
+                                       uint32_t timeout_ms = 0);
+
+    /**
+     * @brief Wartet auf das Ende einer mit start_provisioning_async() gestarteten Provisionierung.
+     * @param timeout Maximale Wartezeit in Ticks (portMAX_DELAY = unbegrenzt, 0 = nur abfragen).
+     * @return esp_err_t Das Ergebnis (siehe provisioning_callback_t); ESP_ERR_TIMEOUT, wenn das Portal
+     * noch läuft; ESP_ERR_INVALID_STATE, wenn keine Provisionierung gestartet wurde.
+     */
+    esp_err_t wait_provisioning(TickType_t timeout = portMAX_DELAY);
+
+    /**
+     * @brief Bricht eine laufende Provisionierung ab und wartet, bis alle Dienste beendet sind.
+     * @note Nicht aus dem `on_complete`-Callback aufrufen.
+     * @return esp_err_t ESP_OK; ESP_ERR_INVALID_STATE, wenn keine Provisionierung läuft.
+     */
+    esp_err_t cancel_provisioning();
+
+    /**
+     * @brief Prüft, ob das Captive Portal gerade läuft.
+     */
+    bool is_provisioning() const;
+
     /**
      * @brief Prüft, ob gültige WLAN-Zugangsdaten dauerhaft im NVS gespeichert sind.
      */
@@ -136,10 +246,26 @@ public:
 
     /**
      * @brief Lädt dauerhaft gespeicherte Zugangsdaten aus dem NVS in die Klasse.
+     *
+     * Sind mehrere Netzwerke gespeichert, wird das zuletzt verbundene geladen. Ist es nicht bekannt,
+     * scannt connect_sta() und wählt das beste Netzwerk nach Signalstärke und Verlauf.
      * @return esp_err_t ESP_OK bei Erfolg.
      */
     esp_err_t get_credentials();
 
+    /**
+     * @brief Liefert die gespeicherten Netzwerke samt Verlauf, das zuletzt eingerichtete zuerst.
+     * @param networks Zielpuffer für höchstens `max_networks` Einträge.
+     * @return Anzahl der geschriebenen Einträge (0, wenn nichts gespeichert ist).
+     */
+    size_t get_networks(wifi_network_info_t *networks, size_t max_networks);
+
+    /**
+     * @brief Entfernt ein gespeichertes Netzwerk; war es das letzte, ist das Gerät danach nicht mehr provisioniert.
+     * @return esp_err_t ESP_OK; ESP_ERR_NOT_FOUND, wenn das Netzwerk nicht gespeichert ist.
+     */
+    esp_err_t remove_network(const std::string& ssid);
+
     /**
      * @brief Versucht, eine Verbindung mit den in der Klasse gespeicherten Zugangsdaten herzustellen.
      *
@@ -160,24 +286,64 @@ public:
      */
     bool is_time_synchronized() const;
 
+    /**
+     * @brief Zeitstempel der Start- und Verbindungsphasen dieses Starts (ms seit dem Start, 0 = nicht erreicht).
+     */
+    const boot_timing_t& get_boot_timing() const;
+
+    /**
+     * @brief Minimum, Median und Maximum je Phase über die letzten BOOT_TIMING_HISTORY_LEN Starts (aus dem NVS).
+     * @return esp_err_t ESP_OK bei Erfolg.
+     */
+    esp_err_t get_boot_timing_summary(boot_timing_summary_t& summary) const;
+
+    /**
+     * @brief Gibt die Zeiten dieses Starts zusammen mit der Auswertung des Verlaufs im Log aus.
+     */
+    void log_boot_timing() const;
+
 private:
     void init_wifi_();
 
-    esp_err_t start_ap_(const std::string& ssid, const std::string& password);
+    esp_err_t start_ap_(const std::string& ssid, const std::string& password, uint8_t channel);
     void stop_ap_(); 
 
     esp_err_t start_web_server_();
     void stop_web_server_();
+    esp_err_t start_provisioning_services_();
+    void stop_provisioning_services_();
 
-    static esp_err_t root_get_handler_(httpd_req_t *req);
+    // Prüfung der Zugangsdaten im Portal (APSTA), Ergebnis über /status
+    enum validation_state_t : uint8_t {
+        VALIDATION_IDLE,
+        VALIDATION_CONNECTING,
+        VALIDATION_CONNECTED,
+        VALIDATION_FAILED,
+    };
+    void start_validation_();
+    void finish_validation_(validation_state_t state, uint8_t reason);
+    void on_validation_disconnect_(uint8_t reason);
+    static void validation_timer_cb_(void *arg);
+    static void provisioning_task_(void *arg);
+
+    static esp_err_t asset_get_handler_(httpd_req_t *req);
     static esp_err_t scan_get_handler_(httpd_req_t *req);
+    static esp_err_t scan_events_handler_(httpd_req_t *req);
     static esp_err_t save_post_handler_(httpd_req_t *req);
-    static esp_err_t style_get_handler_(httpd_req_t *req);
+    static esp_err_t status_get_handler_(httpd_req_t *req);
+    static esp_err_t tz_get_handler_(httpd_req_t *req);
     static esp_err_t captive_portal_handler_(httpd_req_t *req);
+    static esp_err_t probe_get_handler_(httpd_req_t *req);
+    static esp_err_t captive_api_get_handler_(httpd_req_t *req);
 
     esp_err_t load_credentials_from_nvs_(std::string& ssid, std::string& password, std::string& timezone);
     esp_err_t save_credentials_to_nvs_();
 
+    // Auswahl unter mehreren gespeicherten Netzwerken
+    bool roaming_enabled_();
+    void select_network_();
+    void connect_candidate_();
+
     // Statische Methoden für C-Callbacks
     static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
     static void time_sync_notification_cb(struct timeval *tv);
@@ -190,6 +356,9 @@ private:
     // Gab es schon eine erfolgreiche Verbindung
     bool _has_been_connected = false;
 
+    // get_credentials() hat eines von mehreren Netzwerken ohne Schnellverbindungs-Hinweis geladen
+    bool _select_on_connect = false;
+
     // Dieses Flag wird vom SNTP-Callback auf 'true' gesetzt.
     bool _is_time_synced = false;
 
@@ -198,9 +367,26 @@ private:
 
     // Konfigurations-Flags
     bool _persistent_storage = false;
+    wifi_portal_config_t _portal_config;
     
     // FreeRTOS-Objekte für die Synchronisation
     EventGroupHandle_t _provisioning_event_group;
+
+    // Zustand der laufenden Provisionierung (start_provisioning_async)
+    TaskHandle_t _provisioning_task = nullptr;
+    std::string _ap_ssid;
+    std::string _ap_password;
+    provisioning_callback_t _on_provisioning_complete;
+    uint32_t _provisioning_timeout_ms = 0;
+    esp_err_t _provisioning_result = ESP_ERR_INVALID_STATE;
+
+    // Das Captive Portal läuft; STA-Ereignisse gehören dann zur Verbindungsprüfung
+    volatile bool _portal_active = false;
+    volatile validation_state_t _validation_state = VALIDATION_IDLE;
+    uint8_t _validation_reason = 0;      // Disconnect-Grund (wifi_err_reason_t), 0 = Zeitüberschreitung
+    uint8_t _validation_attempts = 0;
+    esp_timer_handle_t _validation_timer = nullptr;  // VALIDATION_TIMEOUT_MS ab start_validation_()
+    esp_ip4_addr_t _validation_ip = {};
     
     httpd_handle_t server_ = nullptr;
     bool wifi_initialized_ = false;
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""
+Erzeugt aus web/timezones.json (basiert auf https://github.com/nayarsystems/posix_tz_db) den Header
+tz_db.h mit der Zeitzonen-Datenbank für den Endpunkt /tz/.
+
+Pro Region entsteht:
+- die fertige, gzip-komprimierte JSON-Antwort für /tz/<Region> ([["Abidjan","GMT0"], ...]),
+- eine nach Stadt sortierte Tabelle für die Auflösung von /tz/<Region>/<Stadt> per binärer Suche.
+
+Die POSIX-Strings werden nur einmal abgelegt und über ihren Index referenziert.
+"""
+
+import argparse
+import gzip
+import json
+import os
+
+
+def c_string(s):
+    return '"' + s.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def c_bytes(data, indent='    '):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append(indent + ', '.join('0x%02x' % b for b in data[i:i + 16]) + ',')
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('source', help='timezones.json')
+    parser.add_argument('--out', required=True, help='Zu erzeugender Header')
+    args = parser.parse_args()
+
+    with open(args.source, encoding='utf-8') as f:
+        regions = json.load(f)
+
+    posix_strings = sorted({zone['posix'] for zones in regions.values() for zone in zones})
+    posix_index = {p: i for i, p in enumerate(posix_strings)}
+    region_names = sorted(regions)
+
+    out = [
+        '// Automatisch erzeugt von tools/build_tz_db.py - nicht bearbeiten.',
+        '#pragma once',
+        '#include <cstddef>',
+        '#include <cstdint>',
+        '',
+        'struct tz_zone_t {',
+        '    const char *city;',
+        '    uint16_t posix;  // Index in TZ_POSIX',
+        '};',
+        '',
+        'struct tz_region_t {',
+        '    const char *name;',
+        '    const tz_zone_t *zones;  // nach Stadt sortiert',
+        '    uint16_t num_zones;',
+        '    const uint8_t *json_gz;  // gzip-komprimierte Antwort für /tz/<Region>',
+        '    uint16_t json_gz_len;',
+        '};',
+        '',
+        'static const char *const TZ_POSIX[] = {',
+    ]
+    out += ['    %s,' % c_string(p) for p in posix_strings]
+    out += ['};', '']
+
+    for r, name in enumerate(region_names):
+        zones = sorted(regions[name], key=lambda z: z['city'].encode())
+        out.append('static const tz_zone_t TZ_ZONES_%d[] = {' % r)
+        out += ['    {%s, %d},' % (c_string(z['city']), posix_index[z['posix']]) for z in zones]
+        out += ['};', '']
+
+        # Reihenfolge für die Anzeige wie in der Quelldatei
+        payload = json.dumps([[z['city'], z['posix']] for z in regions[name]], separators=(',', ':')).encode()
+        compressed = gzip.compress(payload, compresslevel=9, mtime=0)
+        out.append('static const uint8_t TZ_JSON_GZ_%d[] = {' % r)
+        out.append(c_bytes(compressed))
+        out += ['};', '']
+
+    # Die Regionen sind alphabetisch sortiert, ebenfalls für die binäre Suche
+    out.append('static const tz_region_t TZ_REGIONS[] = {')
+    for r, name in enumerate(region_names):
+        out.append('    {%s, TZ_ZONES_%d, %d, TZ_JSON_GZ_%d, sizeof(TZ_JSON_GZ_%d)},'
+                   % (c_string(name), r, len(regions[name]), r, r))
+    out += ['};', '']
+    out.append('static constexpr size_t TZ_NUM_REGIONS = sizeof(TZ_REGIONS) / sizeof(TZ_REGIONS[0]);')
+
+    # Liste der Regionen für /tz/
+    out.append('static const char TZ_REGIONS_JSON[] = %s;'
+               % c_string(json.dumps(region_names, separators=(',', ':'))))
+
+    data = ('\n'.join(out) + '\n').encode()
+    if os.path.exists(args.out):
+        with open(args.out, 'rb') as f:
+            if f.read() == data:
+                return
+    os.makedirs(os.path.dirname(os.path.abspath(args.out)), exist_ok=True)
+    with open(args.out, 'wb') as f:
+        f.write(data)
+
+
+if __name__ == '__main__':
+    main()
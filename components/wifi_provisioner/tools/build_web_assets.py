@@ -0,0 +1,373 @@
+#!/usr/bin/env python3
+"""
+Bereitet die Web-Dateien des Captive Portals zur Build-Zeit auf.
+
+Für jede Eingabedatei wird eine gzip-komprimierte Kopie `<name>.gz` erzeugt, die anschließend per
+`target_add_binary_data` in die Firmware eingebettet wird. Zusätzlich entsteht ein Header mit einem
+Content-Hash (ETag) pro Datei und einer Tabelle aller Routen (WEB_ROUTES): Pfad, MIME-Typ, Encoding
+und ein Zeiger auf die eingebetteten Daten je Sprache. Sprachvarianten heißen `index_<lang>.html`;
+die zuerst angegebene Seite legt die Standard-Sprache fest.
+
+Vor der Komprimierung werden HTML, CSS und das eingebettete JavaScript minifiziert (Kommentare,
+Einrückung und überflüssige Leerzeichen entfernt). Der Minifier ist bewusst konservativ: Strings und
+reguläre Ausdrücke bleiben unverändert, in Template-Literalen wird nur der Leerraum von HTML-Fragmenten
+zusammengefasst. Zeilenumbrüche im JavaScript werden nur dort entfernt, wo sie keine Anweisung beenden
+können.
+
+Mit `--inline-css` wird ein `<link rel="stylesheet" href="/style.css">` durch den Inhalt des
+Stylesheets ersetzt, sodass die Seite mit einer einzigen Anfrage vollständig ist. Ohne diese Option
+erhalten Verweise aus HTML-Dateien auf andere Assets den Hash als Query-Parameter
+("/style.css?v=<etag>"). Dadurch kann das Stylesheet mit langer Cache-Dauer ausgeliefert werden und
+wird trotzdem neu geladen, sobald sich sein Inhalt ändert.
+
+Nur die Python-Standardbibliothek wird benötigt.
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+
+
+MIME_TYPES = {
+    '.html': 'text/html',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+    '.json': 'application/json',
+    '.svg': 'image/svg+xml',
+    '.ico': 'image/x-icon',
+}
+
+
+def symbol_name(filename):
+    return re.sub(r'[^A-Za-z0-9]', '_', filename).upper()
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+# Elemente, zwischen denen reiner Leerraum keine Darstellung hat und daher ganz entfallen kann.
+# Bei allen anderen (z.B. span, button, input) bleibt ein einzelnes Leerzeichen erhalten.
+BLOCK_TAGS = {
+    'html', 'head', 'body', 'title', 'meta', 'link', 'script', 'style', 'div', 'form', 'p', 'br',
+    'h1', 'h2', 'h3', 'h4', 'h5', 'h6', 'ul', 'ol', 'li', 'option', 'svg', 'path', '!doctype',
+}
+
+# Inhalt dieser Elemente wird nicht als HTML-Text behandelt
+RAW_TAGS = ('script', 'style', 'pre', 'textarea')
+
+# Nach diesen Zeichen kann ein JavaScript-Zeilenumbruch keine Anweisung beenden
+JS_CONTINUATION = set('{;,([:=?&|')
+
+# Nach diesen Zeichen beginnt ein '/' einen regulären Ausdruck statt einer Division
+JS_REGEX_PREFIX = set('(,=:[!&|?{};+-*%<>~^')
+
+
+def is_word_char(c):
+    return c.isalnum() or c in '_$'
+
+
+def minify_css(text):
+    out = []
+    i = 0
+    n = len(text)
+    while i < n:
+        c = text[i]
+        if text.startswith('/*', i):
+            end = text.find('*/', i + 2)
+            i = n if end < 0 else end + 2
+            continue
+        if c in '"\'':
+            end = i + 1
+            while end < n and text[end] != c:
+                end += 2 if text[end] == '\\' else 1
+            out.append(text[i:end + 1])
+            i = end + 1
+            continue
+        if c.isspace():
+            while i < n and text[i].isspace():
+                i += 1
+            # Vor '{' usw. entfällt das Leerzeichen; vor ':' nicht, sonst wird aus "a :hover" "a:hover"
+            prev = out[-1][-1] if out else ''
+            if prev and prev not in '{};,>:' and i < n and text[i] not in '{};,>':
+                out.append(' ')
+            continue
+        if c in '{};,>:' and out and out[-1] == ' ' and c != ':':
+            out.pop()
+        out.append(c)
+        i += 1
+    return ''.join(out).replace(';}', '}').strip()
+
+
+def minify_js(text):
+    out = []
+    i = 0
+    n = len(text)
+    pending_space = False
+    pending_newline = False
+
+    def last_char():
+        return out[-1][-1] if out else ''
+
+    def emit(token):
+        nonlocal pending_space, pending_newline
+        prev = last_char()
+        if pending_newline and prev and prev not in JS_CONTINUATION and token[0] not in '}).,':
+            out.append('\n')
+        elif (pending_space or pending_newline) and prev and (
+                (is_word_char(prev) and is_word_char(token[0])) or (prev in '+-' and token[0] == prev)):
+            out.append(' ')
+        pending_space = pending_newline = False
+        out.append(token)
+
+    while i < n:
+        c = text[i]
+        if text.startswith('//', i):
+            end = text.find('\n', i)
+            i = n if end < 0 else end
+            continue
+        if text.startswith('/*', i):
+            end = text.find('*/', i + 2)
+            i = n if end < 0 else end + 2
+            pending_space = True
+            continue
+        if c.isspace():
+            if c == '\n':
+                pending_newline = True
+            else:
+                pending_space = True
+            i += 1
+            continue
+        if c in '"\'`' or (c == '/' and (not last_char() or last_char() in JS_REGEX_PREFIX)):
+            # Strings, Template-Literale und reguläre Ausdrücke als Ganzes übernehmen
+            end = i + 1
+            in_class = False
+            while end < n:
+                ch = text[end]
+                if ch == '\\':
+                    end += 2
+                    continue
+                if c == '/' and ch == '[':
+                    in_class = True
+                elif c == '/' and ch == ']':
+                    in_class = False
+                elif ch == c and not in_class:
+                    break
+                end += 1
+            end += 1
+            if c == '/':
+                while end < n and text[end].isalpha():
+                    end += 1
+            token = text[i:end]
+            if c == '`' and token[1:].lstrip().startswith('<'):
+                # HTML-Fragment für innerHTML: Leerraum wird vom Browser ohnehin zusammengefasst
+                token = collapse_html_whitespace(token)
+            emit(token)
+            i = end
+            continue
+        end = i + 1
+        if is_word_char(c):
+            while end < n and is_word_char(text[end]):
+                end += 1
+        emit(text[i:end])
+        i = end
+    return ''.join(out)
+
+
+def inline_stylesheets(text, css_inline):
+    """
+    Ersetzt <link rel="stylesheet" href="/<datei>"> durch den Inhalt aus css_inline ({dateiname: CSS}).
+    """
+    def replace_link(m):
+        name = m.group(1)
+        return '<style>%s</style>' % css_inline[name] if name in css_inline else m.group(0)
+    return re.sub(r'<link\s+rel="stylesheet"\s+href="/([^"]+)"\s*/?>', replace_link, text)
+
+
+def minify_html(text, css_inline=None):
+    """
+    Minifiziert eine HTML-Seite samt <script>- und <style>-Blöcken.
+    css_inline: {dateiname: minifiziertes CSS}, das anstelle des <link>-Tags eingesetzt wird.
+    """
+    text = re.sub(r'<!--.*?-->', '', text, flags=re.S)
+
+    if css_inline:
+        text = inline_stylesheets(text, css_inline)
+
+    parts = []
+    pos = 0
+    for m in re.finditer(r'<(%s)\b[^>]*>(.*?)</\1>' % '|'.join(RAW_TAGS), text, flags=re.S | re.I):
+        parts.append(('html', text[pos:m.start(2)]))
+        parts.append((m.group(1).lower(), m.group(2)))
+        pos = m.end(2)
+    parts.append(('html', text[pos:]))
+
+    out = []
+    for kind, chunk in parts:
+        if kind == 'script':
+            out.append(minify_js(chunk))
+        elif kind == 'style':
+            out.append(minify_css(chunk))
+        elif kind != 'html':
+            out.append(chunk)
+        else:
+            out.append(collapse_html_whitespace(chunk))
+    return ''.join(out).strip()
+
+
+def collapse_html_whitespace(chunk):
+    def tag_name(tag):
+        m = re.match(r'</?([!A-Za-z][A-Za-z0-9]*)', tag)
+        return m.group(1).lower() if m else ''
+
+    tokens = re.split(r'(<[^>]*>)', chunk)
+    for i, token in enumerate(tokens):
+        if token.startswith('<'):
+            continue
+        collapsed = re.sub(r'\s+', ' ', token)
+        if collapsed == ' ':
+            before = tag_name(tokens[i - 1]) if i > 0 else ''
+            after = tag_name(tokens[i + 1]) if i + 1 < len(tokens) else ''
+            if i == 0 or i == len(tokens) - 1 or before in BLOCK_TAGS or after in BLOCK_TAGS:
+                collapsed = ''
+        tokens[i] = collapsed
+    return ''.join(tokens)
+
+
+def minify(name, data, css_inline=None):
+    if name.endswith('.html'):
+        return minify_html(data.decode('utf-8'), css_inline).encode('utf-8')
+    if name.endswith('.css'):
+        return minify_css(data.decode('utf-8')).encode('utf-8')
+    return data
+
+
+def write_if_changed(path, data):
+    # Unveränderte Dateien nicht anfassen, damit nichts unnötig neu gebaut wird
+    if os.path.exists(path):
+        with open(path, 'rb') as f:
+            if f.read() == data:
+                return
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--out-dir', required=True, help='Zielverzeichnis für die erzeugten Dateien')
+    parser.add_argument('--header', required=True, help='Name des erzeugten C-Headers')
+    parser.add_argument('--inline-css', action='store_true', help='Stylesheets direkt in die HTML-Seiten einsetzen')
+    parser.add_argument('--no-minify', action='store_true', help='Dateien unverändert übernehmen (zur Fehlersuche)')
+    parser.add_argument('files', nargs='+', help='Web-Dateien (HTML zuletzt verarbeitet)')
+    args = parser.parse_args()
+
+    os.makedirs(args.out_dir, exist_ok=True)
+
+    # Nicht-HTML-Dateien zuerst, damit ihre Hashes in die HTML-Dateien eingesetzt werden können
+    files = sorted(args.files, key=lambda p: p.endswith('.html'))
+    etags = {}
+    css_inline = {}
+
+    for path in files:
+        name = os.path.basename(path)
+        with open(path, 'rb') as f:
+            data = f.read()
+
+        if not args.no_minify:
+            data = minify(name, data, css_inline)
+        elif css_inline and name.endswith('.html'):
+            # Auch unminifiziert gilt --inline-css, damit sich die Seite nur in der Formatierung unterscheidet
+            data = inline_stylesheets(data.decode('utf-8'), css_inline).encode('utf-8')
+        if args.inline_css and name.endswith('.css'):
+            css_inline[name] = data.decode('utf-8')
+
+        if name.endswith('.html'):
+            for asset, etag in etags.items():
+                data = data.replace(b'"/%s"' % asset.encode(), b'"/%s?v=%s"' % (asset.encode(), etag.encode()))
+
+        etags[name] = content_hash(data)
+        write_if_changed(os.path.join(args.out_dir, name + '.gz'), gzip.compress(data, compresslevel=9, mtime=0))
+
+    write_if_changed(os.path.join(args.out_dir, args.header), registry_header(files, etags).encode())
+
+
+def route_of(name):
+    """
+    Liefert (URL-Pfad, Sprache) einer Datei. `index_<lang>.html` wird unter "/" ausgeliefert,
+    `<name>_<lang>.html` unter "/<name>.html"; alle anderen Dateien gelten für jede Sprache.
+    """
+    m = re.match(r'^(.*)_([a-z]{2})\.html$', name)
+    if m:
+        base = m.group(1)
+        return ('/' if base == 'index' else '/%s.html' % base), m.group(2)
+    return '/' + name, None
+
+
+def registry_header(files, etags):
+    names = [os.path.basename(p) for p in files]
+    routes = {}
+    langs = []
+    for name in names:
+        path, lang = route_of(name)
+        routes.setdefault(path, {})[lang] = name
+        if lang and lang not in langs:
+            langs.append(lang)
+
+    # Die Sprache der zuerst angegebenen Seite ist die Standard-Sprache (Reihenfolge in `files`)
+    if not langs:
+        langs = ['en']
+
+    lines = [
+        '// Automatisch erzeugt von tools/build_web_assets.py - nicht bearbeiten.',
+        '#pragma once',
+        '#include <cstddef>',
+        '#include <cstdint>',
+        '',
+    ]
+    for name in names:
+        lines.append('#define WEB_ETAG_%s "\\"%s\\""' % (symbol_name(name), etags[name]))
+
+    lines += [
+        '',
+        '// Sprachen der Seiten; Index 0 ist die Standard-Sprache',
+        '#define WEB_NUM_LANGS %d' % len(langs),
+        'static constexpr const char *WEB_LANGS[WEB_NUM_LANGS] = {%s};' % ', '.join('"%s"' % l for l in langs),
+        '',
+        'struct web_asset_t {',
+        '    const char *mime;',
+        '    const char *encoding;   // Content-Encoding',
+        '    const char *etag;',
+        '    const uint8_t *start;   // Eingebettete Daten im Flash (target_add_binary_data)',
+        '    const uint8_t *end;',
+        '    bool revalidate;        // true: bei jedem Aufruf revalidieren, false: dauerhaft cachebar',
+        '};',
+        '',
+        'struct web_route_t {',
+        '    const char *path;',
+        '    const web_asset_t *variants[WEB_NUM_LANGS]; // Index wie in WEB_LANGS',
+        '};',
+        '',
+    ]
+    for name in names:
+        sym = re.sub(r'[^A-Za-z0-9]', '_', name + '.gz')
+        lines.append('extern const uint8_t %s_start[] asm("_binary_%s_start");' % (sym, sym))
+        lines.append('extern const uint8_t %s_end[] asm("_binary_%s_end");' % (sym, sym))
+    lines.append('')
+    for name in names:
+        sym = re.sub(r'[^A-Za-z0-9]', '_', name + '.gz')
+        ext = os.path.splitext(name)[1]
+        lines.append('static constexpr web_asset_t WEB_ASSET_%s = {"%s", "gzip", WEB_ETAG_%s, %s_start, %s_end, %s};' % (
+            symbol_name(name), MIME_TYPES.get(ext, 'application/octet-stream'), symbol_name(name), sym, sym,
+            'true' if ext == '.html' else 'false'))
+    lines += ['', 'static constexpr web_route_t WEB_ROUTES[] = {']
+    for path, variants in routes.items():
+        fallback = variants.get(langs[0]) or variants.get(None) or next(iter(variants.values()))
+        refs = ['&WEB_ASSET_%s' % symbol_name(variants.get(l) or variants.get(None) or fallback) for l in langs]
+        lines.append('    {"%s", {%s}},' % (path, ', '.join(refs)))
+    lines += ['};', '#define WEB_NUM_ROUTES (sizeof(WEB_ROUTES) / sizeof(WEB_ROUTES[0]))', '']
+    return '\n'.join(lines)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""
+Lasttest für das Captive Portal: simuliert mehrere gleichzeitig eingerichtete Geräte gegen einen
+laufenden ESP32 (Laptop mit dem Setup-WLAN verbinden, dann z.B.
+
+    python3 tools/portal_load_test.py --clients 1,2,4,8 --idle 4
+
+aufrufen).
+
+Jeder simulierte Client verhält sich wie ein Telefon im Captive-Portal-Fenster: Konnektivitäts-Check
+(Umleitung), Seite (gzip, danach 304 per ETag), Netzwerkliste und Zeitzonen, jeweils über eine
+Keep-Alive-Verbindung; gelegentlich wird eine zweite Verbindung geöffnet, wie es Browser tun.
+Zusätzlich können mit --idle Verbindungen geöffnet und ungenutzt gehalten werden (Hintergrund-Proben
+anderer Geräte); mit lru_purge_enable schließt der Server diese, sobald die Sockets knapp werden.
+
+Ausgegeben wird pro Stufe die Anzahl erfolgreicher/fehlgeschlagener Anfragen, abgewiesene oder
+zurückgesetzte Verbindungen sowie p50/p90/max der Antwortzeit. Benötigt nur die Standardbibliothek.
+"""
+
+import argparse
+import asyncio
+import random
+import statistics
+import time
+
+# Ablauf eines Clients: (Pfad, erwartete Statuscodes)
+SESSION = [
+    ('/generate_204', (302,)),
+    ('/', (200, 304)),
+    ('/scan.json', (200,)),
+    ('/tz/', (200, 304)),
+    ('/scan.json?refresh=1', (200,)),
+]
+
+
+class Stats:
+    def __init__(self):
+        self.latencies = []
+        self.ok = 0
+        self.failed = 0
+        self.conn_errors = 0
+        self.purged = 0
+
+    def summary(self):
+        lat = sorted(self.latencies)
+        if lat:
+            p50 = statistics.median(lat)
+            p90 = lat[min(len(lat) - 1, int(len(lat) * 0.9))]
+            mx = lat[-1]
+        else:
+            p50 = p90 = mx = float('nan')
+        return self.ok, self.failed, self.conn_errors, self.purged, p50 * 1000, p90 * 1000, mx * 1000
+
+
+class Connection:
+    """Eine HTTP/1.1-Verbindung mit Keep-Alive; baut bei Bedarf neu auf."""
+
+    def __init__(self, host, port, timeout, stats):
+        self.host = host
+        self.port = port
+        self.timeout = timeout
+        self.stats = stats
+        self.reader = None
+        self.writer = None
+        self.etags = {}
+
+    async def _connect(self):
+        self.reader, self.writer = await asyncio.wait_for(
+            asyncio.open_connection(self.host, self.port), self.timeout)
+
+    def close(self):
+        if self.writer is not None:
+            self.writer.close()
+        self.reader = self.writer = None
+
+    async def _read_response(self):
+        status_line = await self.reader.readline()
+        if not status_line:
+            raise ConnectionResetError('connection closed by server')
+        status = int(status_line.split()[1])
+        headers = {}
+        while True:
+            line = await self.reader.readline()
+            if line in (b'\r\n', b'\n', b''):
+                break
+            name, _, value = line.decode('latin-1').partition(':')
+            headers[name.strip().lower()] = value.strip()
+
+        if headers.get('transfer-encoding', '').lower() == 'chunked':
+            while True:
+                size = int((await self.reader.readline()).split(b';')[0], 16)
+                await self.reader.readexactly(size + 2)
+                if size == 0:
+                    break
+        elif 'content-length' in headers:
+            await self.reader.readexactly(int(headers['content-length']))
+        return status, headers
+
+    async def get(self, path):
+        for attempt in range(2):
+            reused = self.writer is not None
+            try:
+                if not reused:
+                    await self._connect()
+                request = 'GET %s HTTP/1.1\r\nHost: %s\r\nAccept-Encoding: gzip\r\nAccept-Language: de-DE,de;q=0.9\r\n' % (
+                    path, self.host)
+                if path in self.etags:
+                    request += 'If-None-Match: %s\r\n' % self.etags[path]
+                self.writer.write((request + '\r\n').encode())
+                start = time.monotonic()
+                status, headers = await asyncio.wait_for(self._read_response(), self.timeout)
+                self.stats.latencies.append(time.monotonic() - start)
+                if 'etag' in headers:
+                    self.etags[path] = headers['etag']
+                if headers.get('connection', '').lower() == 'close':
+                    self.close()
+                return status
+            except (ConnectionError, asyncio.IncompleteReadError, OSError) as e:
+                self.close()
+                if reused and attempt == 0:
+                    # Leerlaufende Verbindung wurde vom Server geschlossen (LRU-Purge): neu verbinden
+                    self.stats.purged += 1
+                    continue
+                self.stats.conn_errors += 1
+                raise e
+            except asyncio.TimeoutError:
+                self.close()
+                self.stats.conn_errors += 1
+                raise
+        raise ConnectionError('unreachable')
+
+
+async def run_client(args, stats, rounds):
+    conns = [Connection(args.host, args.port, args.timeout, stats)]
+    try:
+        for _ in range(rounds):
+            for path, expected in SESSION:
+                # Browser verteilen Anfragen teils auf eine zweite Verbindung
+                if len(conns) == 1 and random.random() < 0.3:
+                    conns.append(Connection(args.host, args.port, args.timeout, stats))
+                conn = random.choice(conns)
+                try:
+                    status = await conn.get(path)
+                except (ConnectionError, asyncio.IncompleteReadError, asyncio.TimeoutError, OSError):
+                    stats.failed += 1
+                    continue
+                if status in expected:
+                    stats.ok += 1
+                else:
+                    stats.failed += 1
+                await asyncio.sleep(random.uniform(0, args.think_time))
+    finally:
+        for conn in conns:
+            conn.close()
+
+
+async def hold_idle(args, stop):
+    writers = []
+    for _ in range(args.idle):
+        try:
+            _, writer = await asyncio.wait_for(asyncio.open_connection(args.host, args.port), args.timeout)
+            writers.append(writer)
+        except (OSError, asyncio.TimeoutError):
+            pass
+    await stop.wait()
+    for writer in writers:
+        writer.close()
+    return len(writers)
+
+
+async def run_level(args, clients):
+    stats = Stats()
+    stop = asyncio.Event()
+    idle_task = asyncio.create_task(hold_idle(args, stop))
+    await asyncio.sleep(0.2)
+    start = time.monotonic()
+    await asyncio.gather(*(run_client(args, stats, args.rounds) for _ in range(clients)))
+    duration = time.monotonic() - start
+    stop.set()
+    idle = await idle_task
+    return stats, duration, idle
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Load test for the captive portal web server')
+    parser.add_argument('--host', default='192.168.4.1')
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--clients', default='1,2,4,8',
+                        help='Comma-separated list of concurrent client counts to test')
+    parser.add_argument('--rounds', type=int, default=3, help='Sessions per client')
+    parser.add_argument('--idle', type=int, default=0, help='Idle keep-alive connections held open during each level')
+    parser.add_argument('--think-time', type=float, default=0.2, help='Maximum pause between requests in seconds')
+    parser.add_argument('--timeout', type=float, default=10.0)
+    args = parser.parse_args()
+
+    print('clients  idle     ok  failed  conn_err  purged   p50 ms   p90 ms   max ms   req/s')
+    for clients in (int(c) for c in args.clients.split(',')):
+        stats, duration, idle = asyncio.run(run_level(args, clients))
+        ok, failed, conn_errors, purged, p50, p90, mx = stats.summary()
+        print('%7d %5d %6d %7d %9d %7d %8.1f %8.1f %8.1f %7.1f' % (
+            clients, idle, ok, failed, conn_errors, purged, p50, p90, mx, (ok + failed) / duration))
+
+
+if __name__ == '__main__':
+    main()
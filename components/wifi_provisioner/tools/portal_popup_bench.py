@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""
+Misst, wie schnell das Captive Portal für die einzelnen Betriebssystem-Familien erscheint (Laptop mit
+dem Setup-WLAN verbinden, dann z.B.
+
+    python3 tools/portal_popup_bench.py --runs 20
+
+aufrufen).
+
+Für jede Familie wird der Ablauf nachgestellt, den das System nach der Verbindung durchläuft:
+
+1. DNS-Anfrage (A) für den Host des Konnektivitäts-Checks an den DNS-Server des ESP32,
+2. HTTP-GET auf den Check-Pfad an die erhaltene Adresse (erwartet wird eine Umleitung statt 204/"Success"),
+3. Laden der Seite, auf die umgeleitet wurde (so öffnet das Anmeldefenster).
+
+Jeder Schritt verwendet eine neue Verbindung, wie es die Systeme tun. Ausgegeben werden je Familie
+Median und p90 der einzelnen Schritte und der Gesamtzeit bis zur geladenen Seite sowie die erhaltenen
+Statuscodes. Benötigt nur die Standardbibliothek.
+"""
+
+import argparse
+import random
+import socket
+import statistics
+import struct
+import time
+from urllib.parse import urlsplit
+
+# Familie: (Host, Pfad) des Konnektivitäts-Checks
+FAMILIES = [
+    ('Android', 'connectivitycheck.gstatic.com', '/generate_204'),
+    ('Apple', 'captive.apple.com', '/hotspot-detect.html'),
+    ('Windows', 'www.msftconnecttest.com', '/connecttest.txt'),
+    ('Firefox', 'detectportal.firefox.com', '/canonical.html'),
+    ('NetworkManager', 'nmcheck.gnome.org', '/check_network_status.txt'),
+]
+
+# Antworten, mit denen das System annimmt, dass es kein Portal gibt
+NO_PORTAL_STATUS = (204,)
+
+
+def dns_query(server, port, name, timeout):
+    """Fragt den A-Record von `name` ab und liefert die erste Adresse."""
+    query_id = random.randrange(0x10000)
+    packet = struct.pack('>HHHHHH', query_id, 0x0100, 1, 0, 0, 0)
+    for label in name.split('.'):
+        packet += bytes([len(label)]) + label.encode()
+    packet += b'\x00' + struct.pack('>HH', 1, 1)
+
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+        sock.settimeout(timeout)
+        sock.sendto(packet, (server, port))
+        while True:
+            response, _ = sock.recvfrom(512)
+            if len(response) >= 12 and struct.unpack('>H', response[:2])[0] == query_id:
+                break
+
+    ancount = struct.unpack('>H', response[6:8])[0]
+    if ancount == 0:
+        raise RuntimeError('no answer for %s' % name)
+    pos = len(packet)  # Die Antwort wiederholt die Frage unverändert
+    for _ in range(ancount):
+        if response[pos] & 0xC0 == 0xC0:
+            pos += 2
+        else:
+            while response[pos] != 0:
+                pos += response[pos] + 1
+            pos += 1
+        rtype, _, _, rdlength = struct.unpack('>HHIH', response[pos:pos + 10])
+        pos += 10
+        if rtype == 1 and rdlength == 4:
+            return socket.inet_ntoa(response[pos:pos + 4])
+        pos += rdlength
+    raise RuntimeError('no A record for %s' % name)
+
+
+def http_get(ip, port, host, path, timeout):
+    """Einfacher GET über eine neue Verbindung; liefert Statuscode und Header."""
+    with socket.create_connection((ip, port), timeout) as sock:
+        request = ('GET %s HTTP/1.1\r\nHost: %s\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n'
+                   % (path, host))
+        sock.sendall(request.encode())
+        data = b''
+        while True:
+            chunk = sock.recv(4096)
+            if not chunk:
+                break
+            data += chunk
+    head, _, _ = data.partition(b'\r\n\r\n')
+    lines = head.decode('latin-1').split('\r\n')
+    status = int(lines[0].split()[1])
+    headers = {}
+    for line in lines[1:]:
+        name, _, value = line.partition(':')
+        headers[name.strip().lower()] = value.strip()
+    return status, headers
+
+
+def run_family(args, host, path):
+    """Ein Durchlauf: liefert (dns_s, probe_s, page_s, Statusfolge)."""
+    t0 = time.monotonic()
+    ip = dns_query(args.dns, args.dns_port, host, args.timeout)
+    t1 = time.monotonic()
+    status, headers = http_get(ip, args.port, host, path, args.timeout)
+    t2 = time.monotonic()
+    statuses = [status]
+    if status in NO_PORTAL_STATUS:
+        return t1 - t0, t2 - t1, 0.0, statuses
+
+    page_s = 0.0
+    location = headers.get('location')
+    if status in (301, 302, 303, 307, 308) and location:
+        target = urlsplit(location)
+        target_ip = target.hostname or ip
+        target_port = target.port or args.port
+        page_status, _ = http_get(target_ip, target_port, target.netloc or host, target.path or '/', args.timeout)
+        page_s = time.monotonic() - t2
+        statuses.append(page_status)
+    return t1 - t0, t2 - t1, page_s, statuses
+
+
+def p90(values):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * 0.9))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure captive portal pop-up time per OS family')
+    parser.add_argument('--dns', default='192.168.4.1', help='DNS server of the portal')
+    parser.add_argument('--dns-port', type=int, default=53)
+    parser.add_argument('--port', type=int, default=80, help='HTTP port of the portal')
+    parser.add_argument('--runs', type=int, default=10, help='Runs per OS family')
+    parser.add_argument('--pause', type=float, default=0.1, help='Pause between runs in seconds')
+    parser.add_argument('--timeout', type=float, default=5.0)
+    args = parser.parse_args()
+
+    print('family            runs  fail   dns ms  probe ms   page ms  total p50  total p90  status')
+    for family, host, path in FAMILIES:
+        dns, probe, page, total = [], [], [], []
+        failures = 0
+        statuses = None
+        for _ in range(args.runs):
+            try:
+                d, p, g, statuses = run_family(args, host, path)
+            except (OSError, RuntimeError, ValueError, IndexError):
+                failures += 1
+                continue
+            if statuses[0] in NO_PORTAL_STATUS or len(statuses) < 2 or statuses[1] != 200:
+                failures += 1  # Das System würde kein Portal (oder eine leere Seite) anzeigen
+            dns.append(d)
+            probe.append(p)
+            page.append(g)
+            total.append(d + p + g)
+            time.sleep(args.pause)
+
+        if not total:
+            print('%-16s %5d %5d   (no successful run)' % (family, args.runs, failures))
+            continue
+        print('%-16s %5d %5d %8.1f %9.1f %9.1f %10.1f %10.1f  %s' % (
+            family, args.runs, failures, statistics.median(dns) * 1000, statistics.median(probe) * 1000,
+            statistics.median(page) * 1000, statistics.median(total) * 1000, p90(total) * 1000,
+            ' -> '.join(str(s) for s in statuses)))
+
+
+if __name__ == '__main__':
+    main()
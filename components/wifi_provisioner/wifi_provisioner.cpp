@@ -1,62 +1,551 @@
 #include "include/wifi_provisioner.hpp"
 #include "esp_wifi.h"
 #include "esp_log.h"
+#include "esp_mac.h"
 #include "esp_event.h"
 #include "nvs_flash.h"
 #include "nvs.h"
-#include "cJSON.h"
-#include <vector>
+#include "dns_server.hpp"
+#include "wifi_scan.hpp"
+#include "form_parser.hpp"
 #include <algorithm>
 #include <cstring>
+#include <strings.h>
+#include <cstdarg>
 #include <string_view>
+#include <array>
 #include <time.h>
+#include "esp_idf_version.h"
+#include "sdkconfig.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "mbedtls/pkcs5.h"
+#include "esp_rom_crc.h"
+#include <cstddef>
 
 static const char *TAG = "WIFI_PROV";
 #define PROV_NVS_NAMESPACE "wifi_prov"
 
-// Bit für Event Group
-#define PROV_SUCCESS_BIT BIT0
+// Zugangsdaten als ein Datensatz (ein Blob, eine Suche im NVS). nvs_set_blob() schreibt einen Eintrag
+// atomar; zusammen mit der CRC ist ein halb aktualisierter Datensatz damit ausgeschlossen. Hinweis für
+// die Schnellverbindung (STA_HINT_NVS_KEY) und PMK (PMK_NVS_KEY) liegen als eigene Schlüssel daneben und
+// werden nur beim Verbindungsaufbau gelesen.
+#define PROV_RECORD_NVS_KEY "cred"
+#define PROV_RECORD_VERSION 2
+#define PROV_TIMEZONE_MAX_LEN 63  // Längster POSIX-String der Datenbank: 36 Zeichen
+static_assert(FORM_TIMEZONE_MAX_LEN == PROV_TIMEZONE_MAX_LEN, "The form must accept every storable timezone");
+
+// Ein gespeichertes Netzwerk samt Verlauf für die Auswahl beim Verbindungsaufbau
+struct __attribute__((packed)) prov_network_t {
+    char ssid[33];
+    char password[65];
+    uint16_t successes;            // Verbindungen bis zur IP-Adresse
+    uint16_t failures;             // Fehlgeschlagene Verbindungsversuche
+    uint16_t time_to_ip_ms;        // Dauer der letzten erfolgreichen Verbindung
+    uint8_t consecutive_failures;  // Fehlversuche seit der letzten erfolgreichen Verbindung
+};
+
+struct __attribute__((packed)) prov_record_t {
+    uint8_t version;
+    uint8_t num_networks;  // Belegte Einträge; networks[0] wurde zuletzt eingerichtet
+    char timezone[PROV_TIMEZONE_MAX_LEN + 1];
+    prov_network_t networks[WIFI_PROV_MAX_NETWORKS];
+    uint32_t crc;  // CRC32 über alle vorherigen Bytes
+};
+
+// Format 1 mit genau einem Netzwerk; wird beim Laden in das aktuelle Format übernommen
+struct __attribute__((packed)) prov_record_v1_t {
+    uint8_t version;
+    char ssid[33];
+    char password[65];
+    char timezone[PROV_TIMEZONE_MAX_LEN + 1];
+    uint32_t crc;
+};
+
+// Der Datensatz wird beim ersten Zugriff gelesen und danach aus dem RAM bedient
+static prov_record_t s_record;
+static bool s_record_loaded = false;
+// Nach Schlüsseln des alten Formats wird nur einmal pro Start gesucht
+static bool s_legacy_checked = false;
+
+// Bits für Event Group
+#define PROV_SUCCESS_BIT BIT0  // Zugangsdaten empfangen (save_post_handler_)
+#define PROV_CANCEL_BIT  BIT1  // cancel_provisioning()
+#define PROV_DONE_BIT    BIT2  // Dienste beendet, _provisioning_result ist gültig
+
+// Prüfung der eingegebenen Zugangsdaten über die STA-Schnittstelle, während der AP weiterläuft
+#define VALIDATION_TIMEOUT_MS 30000
+#define VALIDATION_MAX_ATTEMPTS 3  // Versuche bei vorübergehenden Fehlern (z.B. Netzwerk nicht gefunden)
+// Nach erfolgreicher Verbindung bleibt das Portal so lange offen, damit die Seite das Ergebnis abholen kann
+#define VALIDATION_RESULT_HOLD_MS 3000
+
+// POST /save: Obergrenze des Bodys (alle Felder vollständig als \uXXXX kodiert sind etwa 1 KB) und
+// Größe der Stücke, in denen er gelesen wird
+#define SAVE_MAX_BODY_LEN 1536
+#define SAVE_RECV_CHUNK_SIZE 128
+
+// Der Task wartet auf die Eingabe und baut danach AP, DNS- und Webserver ab. Das kann nicht im
+// httpd-Task geschehen, weil httpd_stop() nicht aus einem eigenen Handler heraus aufgerufen werden darf.
+#define PROV_TASK_STACK_SIZE 4096
+#define PROV_TASK_PRIORITY 5
+
+// eingebettete, zur Build-Zeit gzip-komprimierte Web-Dateien samt Routen-Tabelle WEB_ROUTES
+// (siehe tools/build_web_assets.py)
+#include "web_assets.h"
+
+// Die Seite selbst wird bei jedem Aufruf revalidiert (meist nur ein 304), das Stylesheet
+// trägt seinen Hash in der URL und darf daher dauerhaft im Cache bleiben.
+#define CACHE_CONTROL_HTML "no-cache"
+#define CACHE_CONTROL_IMMUTABLE "public, max-age=31536000, immutable"
+#define CACHE_CONTROL_TZ "public, max-age=86400"
+
+// Zeitzonen-Datenbank, zur Build-Zeit aus web/timezones.json erzeugt (siehe tools/build_tz_db.py)
+#include "tz_db.h"
+#define TZ_URI_PREFIX "/tz/"
+
+// Konnektivitäts-Checks der Betriebssysteme: Jeder Pfad hat einen eigenen Handler mit exakter Übereinstimmung
+// und erhält sofort eine Umleitung auf das Portal. Jede Antwort außer der erwarteten (204, "Success", ...)
+// lässt das System das Anmeldefenster öffnen; ein 302 ohne Inhalt ist die kürzeste davon.
+enum probe_family_t : uint8_t {
+    PROBE_ANDROID,   // Android, ChromeOS, Chrome
+    PROBE_APPLE,     // iOS, iPadOS, macOS
+    PROBE_WINDOWS,   // Windows NCSI
+    PROBE_FIREFOX,   // Firefox (alle Plattformen)
+    PROBE_LINUX,     // NetworkManager (GNOME, Fedora, ...)
+    PROBE_FAMILY_COUNT
+};
+
+struct probe_route_t {
+    const char *path;
+    probe_family_t family;
+};
+
+static const probe_route_t PROBE_ROUTES[] = {
+    { "/generate_204", PROBE_ANDROID },
+    { "/gen_204", PROBE_ANDROID },
+    { "/hotspot-detect.html", PROBE_APPLE },
+    { "/library/test/success.html", PROBE_APPLE },
+    { "/connecttest.txt", PROBE_WINDOWS },
+    { "/ncsi.txt", PROBE_WINDOWS },
+    { "/redirect", PROBE_WINDOWS },  // Öffnet Windows nach einem fehlgeschlagenen Check im Browser
+    { "/canonical.html", PROBE_FIREFOX },
+    { "/success.txt", PROBE_FIREFOX },
+    { "/check_network_status.txt", PROBE_LINUX },
+};
+#define PROBE_NUM_ROUTES (sizeof(PROBE_ROUTES) / sizeof(PROBE_ROUTES[0]))
+
+static const char *const s_probe_family_names[PROBE_FAMILY_COUNT] = {
+    "Android", "Apple", "Windows", "Firefox", "NetworkManager"
+};
+
+// Ziel der Umleitung; wird beim Start des Access Points aus dessen IP gebildet (siehe configure_ap_netif())
+static char s_portal_url[sizeof("http://255.255.255.255/")] = "http://192.168.4.1/";
+
+// Captive-Portal-API (RFC 8908). Ihre URI wird per DHCP-Option 114 (RFC 8910) verteilt. RFC 8908 verlangt
+// HTTPS für die API und `user-portal-url`; das Gerät hat dafür kein Zertifikat und bietet nur HTTP an.
+// Clients, die das streng prüfen (aktuelle iOS- und Android-Versionen), verwerfen die Option und erkennen
+// das Portal weiter über DNS-Umleitung und Konnektivitäts-Check. Die Option hilft nur Clients, die auch
+// eine HTTP-URI annehmen, und schadet den anderen nicht.
+#define CAPTIVE_API_URI "/api/captive"
+#define DHCP_CAPTIVE_PORTAL_AVAILABLE (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0))
+// Der DHCP-Server von lwIP speichert nur den Zeiger auf die URI, der Puffer muss daher bestehen bleiben
+static char s_captive_api_url[sizeof("http://255.255.255.255" CAPTIVE_API_URI)];
+// Zugriffe je Familie seit dem Start des Portals; der erste wird mit seiner Zeit protokolliert
+static uint32_t s_probe_hits[PROBE_FAMILY_COUNT];
+static TickType_t s_portal_start = 0;
+
+// Obergrenze für gleichzeitig verbundene Stationen am Access Point (Treiber-Grenze des ESP32)
+#define PORTAL_MAX_AP_CLIENTS 10
+
+// httpd belegt zusätzlich zu den Verbindungen drei Sockets (Listen-, Steuer- und Reserve-Socket), der
+// DNS-Server einen pro Interface. Der Rest des lwIP-Limits steht für HTTP-Verbindungen zur Verfügung.
+#define PORTAL_MAX_HTTP_SOCKETS (CONFIG_LWIP_MAX_SOCKETS - 3 - DNS_MAX_LISTENERS)
+
+// Server-Sent Events für den Scan brauchen asynchrone Handler (httpd_req_async_handler_begin).
+// Ohne sie fragt die Seite stattdessen /scan.json ab.
+#define SCAN_EVENTS_AVAILABLE (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0))
+#if SCAN_EVENTS_AVAILABLE
+static void stop_scan_events();
+#endif
+
+// Wiederverbindung mit exponentiellem Backoff: 0,5 s, 1 s, 2 s, ... bis höchstens 60 s, jeweils mit
+// zufälligem Anteil (zwischen der Hälfte und dem vollen Wert), damit nach einem Stromausfall nicht alle
+// Geräte gleichzeitig beim Router anfragen.
+#define RECONNECT_BACKOFF_MIN_MS 500
+#define RECONNECT_BACKOFF_MAX_MS 60000
+
+// Zurück ins Captive Portal geht es nur, solange mit diesen Zugangsdaten in diesem Start noch keine
+// Verbindung zustande kam: nach mehreren Authentifizierungsfehlern (falsches Passwort) oder, wenn die
+// Zugangsdaten auch bei früheren Starts nie funktioniert haben, nach vielen Versuchen, bei denen das
+// Netzwerk nicht gefunden wurde bzw. seine Verschlüsselung nicht passt. Ein Router, mit dem das Gerät
+// schon einmal verbunden war, wird beliebig lange weiter versucht.
+#define RECONNECT_MAX_AUTH_FAILURES 5
+#define RECONNECT_MAX_UNREACHABLE_FAILURES 10
+
+// Verzögerung vor dem Neustart, damit die Log-Ausgabe noch vollständig erscheint
+#define RECONNECT_RESET_DELAY_MS 1000
+
+// Löschen und Neustart laufen in einem eigenen Task, nicht im esp_timer-Task
+#define RECONNECT_RESET_TASK_STACK_SIZE 3072
+#define RECONNECT_RESET_TASK_PRIORITY 5
+
+// Der Boot-Verlauf wird einmal geschrieben, sobald die Zeit synchronisiert ist; ohne SNTP-Antwort
+// spätestens nach dieser Zeit ab der ersten IP-Adresse
+#define BOOT_TIMING_SAVE_TIMEOUT_MS 30000
+
+enum reconnect_action_t {
+    RECONNECT_ACTION_CONNECT,  // esp_wifi_connect()
+    RECONNECT_ACTION_SELECT,   // Scannen und unter mehreren gespeicherten Netzwerken auswählen
+    RECONNECT_ACTION_RESET,    // Zugangsdaten löschen und neu starten
+};
+
+// Zustand der Wiederverbindung; wird nur im Event-Loop-Task verändert
+static esp_timer_handle_t s_reconnect_timer = nullptr;
+static reconnect_action_t s_reconnect_action = RECONNECT_ACTION_CONNECT;
+static uint32_t s_reconnect_attempt = 0;  // Fehlversuche seit der letzten erfolgreichen Verbindung
+static uint32_t s_auth_failures = 0;      // Davon Authentifizierungsfehler
+static uint32_t s_unreachable_failures = 0;  // Davon "nicht gefunden" (siehe is_unreachable_failure())
+static bool s_connected_before = false;   // Beim Start lag ein Hinweis auf eine frühere Verbindung vor
+                                          // (wird nur mit den Zugangsdaten gelöscht)
+
+// Schnellverbindung: BSSID, Kanal und Verschlüsselung der letzten erfolgreichen Verbindung (NVS-Blob)
+#define STA_HINT_NVS_KEY "sta_hint"
+
+struct sta_hint_t {
+    char ssid[33];       // Die Hinweise gelten nur für dieses Netzwerk
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t authmode;    // wifi_auth_mode_t
+};
+
+// Abgeleiteter WPA2-Schlüssel (PMK = PBKDF2-SHA1(Passwort, SSID, 4096, 32)) als NVS-Blob. Der Treiber
+// speichert ihn wegen WIFI_STORAGE_RAM nicht selbst und müsste ihn sonst bei jedem Start neu berechnen.
+#define PMK_NVS_KEY "pmk"
+#define PMK_LEN 32
+#define PMK_ITERATIONS 4096
+
+struct pmk_blob_t {
+    uint32_t owner_crc;  // Zugangsdaten, aus denen der PMK berechnet wurde (siehe pmk_owner_crc())
+    uint8_t pmk[PMK_LEN];
+};
+
+// Der laufende Verbindungsversuch richtet sich direkt an den gespeicherten Access Point
+static bool s_directed_connect = false;
+static TickType_t s_connect_start = 0;
+
+// Auswahl unter mehreren gespeicherten Netzwerken: Nach einem Scan werden die Netzwerke nach Signalstärke
+// und Verlauf bewertet und der Reihe nach versucht, ohne Neustart und ohne Wartezeit dazwischen. Erst wenn
+// alle gescheitert sind, folgt der Backoff. Nicht gesehene Netzwerke (z.B. versteckte SSIDs) kommen zuletzt.
+#define SELECT_MAX_SCAN_RESULTS 20
+#define SELECT_SUCCESS_WEIGHT 20        // dB Bonus für eine Erfolgsquote von 100 %
+#define SELECT_FAILURE_PENALTY 10       // dB Abzug je Fehlversuch in Folge ...
+#define SELECT_MAX_FAILURE_PENALTIES 3  // ... höchstens dreimal
+#define SELECT_MAX_TIME_PENALTY 10      // dB Abzug je Sekunde bis zur IP-Adresse, höchstens
+// Danach werden beide Zähler halbiert, damit jüngere Ergebnisse stärker zählen
+#define SELECT_HISTORY_LIMIT 100
+
+struct select_candidate_t {
+    uint8_t network;  // Index in s_record.networks
+    int8_t rssi;
+    int16_t score;
+    sta_hint_t ap;    // Stärkster Access Point des Netzwerks im Scan; channel 0 = nicht gesehen
+};
+
+// Zustand der Auswahl; wird nur im Event-Loop-Task verändert
+static select_candidate_t s_candidates[WIFI_PROV_MAX_NETWORKS];
+static uint8_t s_num_candidates = 0;
+static uint8_t s_candidate_pos = 0;
+static bool s_selecting = false;        // s_candidates wird gerade abgearbeitet
+static bool s_select_on_start = false;  // Bei STA_START scannen statt direkt zu verbinden
+static volatile bool s_select_scan = false;  // Der laufende Scan gehört zur Auswahl
 
-// Prototypen
-void start_dns_server();
-void stop_dns_server();
+WifiProvisioner* WifiProvisioner::s_instance = nullptr;
 
-// eingebettete 
-extern const char root_html_start[] asm("_binary_index_en_html_start");
-extern const char root_html_end[]   asm("_binary_index_en_html_end");
-extern const char style_css_start[] asm("_binary_style_css_start");
-extern const char style_css_end[]   asm("_binary_style_css_end");
+static uint32_t record_crc(const prov_record_t& record) {
+    return esp_rom_crc32_le(0, (const uint8_t *)&record, offsetof(prov_record_t, crc));
+}
 
-#define WIFI_MAX_RETRIES_INITIAL 5       // Kurze Wartezeit für die erste Verbindung
-#define WIFI_MAX_RETRIES_RECONNECT 3600 // Lange Wartezeit für Wiederverbindung (3600 Versuche * 1s = 1 Stunde)
+/**
+ * @brief Schreibt den Datensatz (mit neuer CRC) in einem Vorgang und übernimmt ihn in den Cache.
+ */
+static esp_err_t store_record(prov_record_t *record) {
+    record->version = PROV_RECORD_VERSION;
+    record->crc = record_crc(*record);
 
-static int s_retry_num = 0;
-static int s_max_retries = WIFI_MAX_RETRIES_INITIAL; // Startet immer mit dem kurzen Limit
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(PROV_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(h, PROV_RECORD_NVS_KEY, record, sizeof(*record));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
 
-WifiProvisioner* WifiProvisioner::s_instance = nullptr;
+    if (err == ESP_OK) {
+        if (record != &s_record) s_record = *record;
+        s_record_loaded = true;
+    } else {
+        s_record_loaded = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Liest einen String-Schlüssel des alten Formats (ein Schlüssel pro Wert) in `out`.
+ */
+static bool read_legacy_str(nvs_handle_t h, const char *key, char *out, size_t out_len) {
+    size_t size = out_len;
+    return nvs_get_str(h, key, out, &size) == ESP_OK;
+}
 
 /**
- * @brief Hilfsfunktion zum Dekodieren eines URL-kodierten Strings.
- * @param out Puffer für den dekodierten String.
- * @param in  Der URL-kodierte Eingabe-String.
+ * @brief Übernimmt Zugangsdaten aus den einzelnen Schlüsseln früherer Versionen (ssid, password,
+ * timezone) in den Datensatz und löscht die alten Schlüssel danach.
+ *
+ * Bricht der Vorgang ab, bleiben die alten Schlüssel erhalten und die Migration läuft beim nächsten
+ * Start erneut; erst wenn der neue Datensatz geschrieben ist, werden sie gelöscht. Ohne alte Schlüssel
+ * wird der Namespace nur lesend geöffnet, und das höchstens einmal pro Start.
  */
-static void url_decode(char *out, const char *in, size_t out_len) {
-    char *end = out + out_len - 1; // Ende des Puffers
-    while (*in && out < end) { // Prüfe Puffergrenze
-        if (*in == '%') {
-            if (in[1] && in[2]) {
-                char hex[3] = { in[1], in[2], '\0' };
-                *out++ = strtol(hex, NULL, 16);
-                in += 3;
+static esp_err_t migrate_legacy_credentials(prov_record_t *record) {
+    if (s_legacy_checked) return ESP_ERR_NVS_NOT_FOUND;
+    s_legacy_checked = true;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(PROV_NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err != ESP_OK) return err;
+    size_t size = 0;
+    err = nvs_get_str(h, "ssid", nullptr, &size);
+    nvs_close(h);
+    if (err != ESP_OK) return err;
+
+    err = nvs_open(PROV_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    memset(record, 0, sizeof(*record));
+    prov_network_t& network = record->networks[0];
+    if (!read_legacy_str(h, "ssid", network.ssid, sizeof(network.ssid)) || network.ssid[0] == '\0') {
+        nvs_close(h);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    read_legacy_str(h, "password", network.password, sizeof(network.password));
+    read_legacy_str(h, "timezone", record->timezone, sizeof(record->timezone));
+    record->num_networks = 1;
+    record->version = PROV_RECORD_VERSION;
+    record->crc = record_crc(*record);
+
+    err = nvs_set_blob(h, PROV_RECORD_NVS_KEY, record, sizeof(*record));
+    if (err == ESP_OK) err = nvs_commit(h);
+    if (err == ESP_OK) {
+        nvs_erase_key(h, "ssid");
+        nvs_erase_key(h, "password");
+        nvs_erase_key(h, "timezone");
+        nvs_commit(h);
+        ESP_LOGI(TAG, "Migrated credentials to versioned NVS record.");
+    }
+    nvs_close(h);
+    return err;
+}
+
+/**
+ * @brief Liest einen Datensatz im Format 1 (ein Netzwerk) und überträgt ihn in das aktuelle Format.
+ */
+static esp_err_t read_record_v1(nvs_handle_t h, prov_record_t *record) {
+    prov_record_v1_t old;
+    size_t size = sizeof(old);
+    esp_err_t err = nvs_get_blob(h, PROV_RECORD_NVS_KEY, &old, &size);
+    if (err != ESP_OK) return err;
+    if (old.version != 1 || old.crc != esp_rom_crc32_le(0, (const uint8_t *)&old, offsetof(prov_record_v1_t, crc))) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    memset(record, 0, sizeof(*record));
+    record->version = PROV_RECORD_VERSION;
+    record->num_networks = 1;
+    memcpy(record->networks[0].ssid, old.ssid, sizeof(old.ssid));
+    memcpy(record->networks[0].password, old.password, sizeof(old.password));
+    memcpy(record->timezone, old.timezone, sizeof(old.timezone));
+    return ESP_OK;
+}
+
+/**
+ * @brief Lädt den Datensatz mit den Zugangsdaten (einmal pro Start, danach aus dem RAM).
+ * @return ESP_OK; ESP_ERR_NVS_NOT_FOUND, wenn keine Zugangsdaten gespeichert sind; ESP_ERR_INVALID_CRC
+ * bei einem beschädigten Datensatz (er wird dann wie nicht vorhanden behandelt).
+ */
+static esp_err_t load_record(prov_record_t *record) {
+    if (s_record_loaded) {
+        if (record != &s_record) *record = s_record;
+        return ESP_OK;
+    }
+
+    bool upgrade = false;
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(PROV_NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err == ESP_OK) {
+        size_t size = 0;
+        err = nvs_get_blob(h, PROV_RECORD_NVS_KEY, nullptr, &size);
+        if (err == ESP_OK && size == sizeof(prov_record_v1_t)) {
+            err = read_record_v1(h, record);
+            upgrade = err == ESP_OK;
+        } else if (err == ESP_OK) {
+            size = sizeof(*record);
+            err = nvs_get_blob(h, PROV_RECORD_NVS_KEY, record, &size);
+            if (err == ESP_OK && (size != sizeof(*record) || record->version != PROV_RECORD_VERSION ||
+                                  record->crc != record_crc(*record) || record->num_networks > WIFI_PROV_MAX_NETWORKS)) {
+                err = ESP_ERR_INVALID_CRC;
             }
-        } else if (*in == '+') {
-            *out++ = ' ';
-            in++;
-        } else {
-            *out++ = *in++;
         }
+        nvs_close(h);
+        if (err == ESP_ERR_INVALID_CRC || err == ESP_ERR_NVS_INVALID_LENGTH) {
+            ESP_LOGE(TAG, "Stored credentials are corrupt or from an unknown version, ignoring them.");
+        }
+    }
+    // Kein Datensatz (oder der Namespace existiert noch nicht): Daten im alten Format übernehmen
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = migrate_legacy_credentials(record);
     }
-    *out = '\0'; // Nullterminierung sicherstellen
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Strings sind laut CRC intakt; die Nullterminierung trotzdem sicherstellen
+    for (uint8_t i = 0; i < record->num_networks; i++) {
+        record->networks[i].ssid[sizeof(record->networks[i].ssid) - 1] = '\0';
+        record->networks[i].password[sizeof(record->networks[i].password) - 1] = '\0';
+    }
+    record->timezone[sizeof(record->timezone) - 1] = '\0';
+
+    // Format 1 einmalig umschreiben; schlägt das fehl, bleibt der alte Datensatz gültig und wird beim
+    // nächsten Start erneut übernommen
+    if (upgrade && store_record(record) == ESP_OK) {
+        ESP_LOGI(TAG, "Upgraded credentials record to version %d.", PROV_RECORD_VERSION);
+    }
+    s_record = *record;
+    s_record_loaded = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Sucht ein gespeichertes Netzwerk; -1, wenn es nicht im Datensatz steht.
+ */
+static int find_network(const prov_record_t& record, const char *ssid) {
+    for (uint8_t i = 0; i < record.num_networks; i++) {
+        if (strncmp(record.networks[i].ssid, ssid, sizeof(record.networks[i].ssid)) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Löscht die gespeicherten Zugangsdaten samt abgeleiteter Daten aus dem NVS.
+ */
+static void erase_credentials_from_nvs() {
+    nvs_handle_t nvs_handle;
+    if (nvs_open(PROV_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) return;
+    nvs_erase_key(nvs_handle, PROV_RECORD_NVS_KEY);
+    s_record_loaded = false;
+    nvs_erase_key(nvs_handle, STA_HINT_NVS_KEY);
+    nvs_erase_key(nvs_handle, PMK_NVS_KEY);
+    nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+}
+
+/**
+ * @brief Startet den Scan für die Auswahl unter mehreren Netzwerken (Ergebnis: WIFI_EVENT_SCAN_DONE).
+ *
+ * Lässt sich der Scan nicht starten, wird mit der aktuellen Konfiguration verbunden; scheitert das,
+ * plant der Event-Handler die Auswahl erneut.
+ */
+static void start_select_scan() {
+    wifi_scan_config_t scan_config = {};
+    s_select_scan = true;
+    esp_err_t err = esp_wifi_scan_start(&scan_config, false);
+    if (err != ESP_OK) {
+        s_select_scan = false;
+        ESP_LOGW(TAG, "Scan for known networks failed (%s), reconnecting instead", esp_err_to_name(err));
+        s_connect_start = xTaskGetTickCount();
+        esp_wifi_connect();
+    }
+}
+
+/**
+ * @brief Löscht die Zugangsdaten und startet neu ins Captive Portal.
+ */
+static void reset_task(void *arg) {
+    erase_credentials_from_nvs();
+    esp_restart();
+}
+
+/**
+ * @brief Callback des Wiederverbindungs-Timers (läuft im esp_timer-Task, nicht im Event-Loop).
+ */
+static void reconnect_timer_cb(void *arg) {
+    if (s_reconnect_action == RECONNECT_ACTION_RESET) {
+        // Flash-Zugriffe blockieren; der esp_timer-Task bedient auch andere Timer
+        if (xTaskCreate(reset_task, "wifi_reset", RECONNECT_RESET_TASK_STACK_SIZE, NULL,
+                        RECONNECT_RESET_TASK_PRIORITY, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create reset task, rebooting without erasing credentials");
+            esp_restart();
+        }
+        return;
+    }
+    if (s_reconnect_action == RECONNECT_ACTION_SELECT) {
+        start_select_scan();
+        return;
+    }
+    s_connect_start = xTaskGetTickCount();
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_wifi_connect failed (%s)", esp_err_to_name(err));
+    }
+}
+
+/**
+ * @brief Nur diese Gründe deuten sicher auf einen falschen Schlüssel hin. Ein Handshake-Timeout kann
+ * auch bei schlechtem Empfang auftreten und zählt daher nicht dazu.
+ */
+static bool is_auth_failure(uint8_t reason) {
+    switch (reason) {
+        case WIFI_REASON_AUTH_FAIL:
+        case WIFI_REASON_MIC_FAILURE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Netzwerk nicht gefunden, Verschlüsselung unterhalb der Schwelle der Konfiguration oder
+ * Handshake ohne Antwort. Vorübergehend bei bekannten Zugangsdaten, bei neuen meist ein Tippfehler in der
+ * SSID, ein falsches Passwort oder ein nicht unterstützter Sicherheitsmodus.
+ */
+static bool is_unreachable_failure(uint8_t reason) {
+    switch (reason) {
+        case WIFI_REASON_NO_AP_FOUND:
+        case WIFI_REASON_NO_AP_FOUND_W_COMPATIBLE_SECURITY:
+        case WIFI_REASON_NO_AP_FOUND_IN_AUTHMODE_THRESHOLD:
+        case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+        case WIFI_REASON_HANDSHAKE_TIMEOUT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Wartezeit vor dem nächsten Versuch: exponentiell wachsend, mit zufälligem Anteil.
+ */
+static uint32_t reconnect_delay_ms(uint32_t attempt) {
+    uint32_t delay = RECONNECT_BACKOFF_MIN_MS << std::min<uint32_t>(attempt, 16);
+    delay = std::min<uint32_t>(delay, RECONNECT_BACKOFF_MAX_MS);
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+/**
+ * @brief Plant die nächste Aktion über den Timer; der Event-Handler selbst kehrt sofort zurück.
+ */
+static void schedule_reconnect(reconnect_action_t action, uint32_t delay_ms) {
+    esp_timer_stop(s_reconnect_timer);  // Ein noch ausstehender Versuch wird ersetzt
+    s_reconnect_action = action;
+    esp_timer_start_once(s_reconnect_timer, (uint64_t)delay_ms * 1000);
 }
 
 // Konstruktor: Erstellt die Event Group
@@ -69,6 +558,12 @@ WifiProvisioner::WifiProvisioner() {
       ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_timing_mark(BOOT_PHASE_NVS_INIT);
+
+    // Volle Länge vorab reservieren, damit save_post_handler_ die Werte ohne Heap übernimmt
+    _ssid.reserve(FORM_SSID_MAX_LEN);
+    _password.reserve(FORM_PASSWORD_MAX_LEN);
+    _timezone.reserve(FORM_TIMEZONE_MAX_LEN);
 
     _provisioning_event_group = xEventGroupCreate();
     init_wifi_();
@@ -76,8 +571,11 @@ WifiProvisioner::WifiProvisioner() {
 
 // Destruktor: Gibt die Event Group frei
 WifiProvisioner::~WifiProvisioner() {
-    stop_web_server_();
-    stop_dns_server();
+    cancel_provisioning();
+    if (_validation_timer) {
+        esp_timer_stop(_validation_timer);
+        esp_timer_delete(_validation_timer);
+    }
     vEventGroupDelete(_provisioning_event_group);
 }
 
@@ -97,12 +595,71 @@ void WifiProvisioner::init_wifi_() {
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, this, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, this, NULL));
 
+    const esp_timer_create_args_t reconnect_timer_args = {
+        .callback = &reconnect_timer_cb,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "wifi_reconnect",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&reconnect_timer_args, &s_reconnect_timer));
+
+    const esp_timer_create_args_t validation_timer_args = {
+        .callback = &validation_timer_cb_,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "wifi_validation",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&validation_timer_args, &_validation_timer));
+
     ESP_LOGI(TAG, "Finished initializing WiFi...");
+    boot_timing_mark(BOOT_PHASE_WIFI_INIT);
 
     wifi_initialized_ = true;
 }
 
-esp_err_t WifiProvisioner::start_ap_(const std::string& ssid, const std::string& password) {
+/**
+ * @brief Setzt Adresse und Netzmaske des Access Points und verteilt die Portal-URI per DHCP.
+ *
+ * Der DHCP-Server wird dafür kurz angehalten; er vergibt Adressen danach aus dem neuen Subnetz und nennt
+ * den Access Point als Gateway und DNS-Server. Die URLs für Umleitungen und /api/captive folgen der Adresse.
+ */
+static void configure_ap_netif(esp_ip4_addr_t ip, esp_ip4_addr_t netmask) {
+    // Host-Anteil 0 (Netzadresse) oder nur Einsen (Broadcast) ist keine gültige Adresse
+    if (netmask.addr == 0 || (ip.addr & ~netmask.addr) == 0 || (ip.addr | netmask.addr) == 0xFFFFFFFF) {
+        ESP_LOGW(TAG, "Invalid AP address " IPSTR "/" IPSTR ", using 192.168.4.1/24", IP2STR(&ip), IP2STR(&netmask));
+        ip.addr = ESP_IP4TOADDR(192, 168, 4, 1);
+        netmask.addr = ESP_IP4TOADDR(255, 255, 255, 0);
+    }
+    snprintf(s_portal_url, sizeof(s_portal_url), "http://" IPSTR "/", IP2STR(&ip));
+    snprintf(s_captive_api_url, sizeof(s_captive_api_url), "http://" IPSTR CAPTIVE_API_URI, IP2STR(&ip));
+
+    esp_netif_t *ap_netif = esp_netif_get_handle_from_ifkey("WIFI_AP_DEF");
+    if (ap_netif == nullptr) return;
+
+    esp_netif_ip_info_t ip_info = {};
+    ip_info.ip = ip;
+    ip_info.gw = ip;
+    ip_info.netmask = netmask;
+    esp_netif_dhcps_stop(ap_netif);  // Meldet einen Fehler, wenn er schon angehalten ist; das ist hier gewollt
+    esp_err_t err = esp_netif_set_ip_info(ap_netif, &ip_info);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set AP address (%s)", esp_err_to_name(err));
+    }
+#if DHCP_CAPTIVE_PORTAL_AVAILABLE
+    err = esp_netif_dhcps_option(ap_netif, ESP_NETIF_OP_SET, ESP_NETIF_CAPTIVEPORTAL_URI,
+                                 s_captive_api_url, strlen(s_captive_api_url));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set DHCP captive portal option (%s)", esp_err_to_name(err));
+    }
+#endif
+    esp_netif_dhcps_start(ap_netif);
+    ESP_LOGI(TAG, "Access point at " IPSTR "/" IPSTR ", captive portal API %s", IP2STR(&ip), IP2STR(&netmask),
+             s_captive_api_url);
+}
+
+esp_err_t WifiProvisioner::start_ap_(const std::string& ssid, const std::string& password, uint8_t channel) {
     wifi_config_t wifi_config = {};
     strncpy((char*)wifi_config.ap.ssid, ssid.c_str(), sizeof(wifi_config.ap.ssid) -1);
 
@@ -113,11 +670,23 @@ esp_err_t WifiProvisioner::start_ap_(const std::string& ssid, const std::string&
     } else {
         wifi_config.ap.authmode = WIFI_AUTH_OPEN;
     }
-    wifi_config.ap.max_connection = 1;
+    wifi_config.ap.max_connection = std::clamp<uint8_t>(_portal_config.max_clients, 1, PORTAL_MAX_AP_CLIENTS);
+
+    wifi_config.ap.beacon_interval = std::clamp<uint16_t>(_portal_config.beacon_interval, 100, 60000);
+
+    configure_ap_netif(_portal_config.ap_ip, _portal_config.ap_netmask);
+
+    wifi_config.ap.channel = channel;  // 0 = Standardkanal des Treibers
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    // Die Sendeleistung lässt sich erst bei laufendem Treiber setzen
+    if (_portal_config.max_tx_power != 0 && esp_wifi_set_max_tx_power(_portal_config.max_tx_power) != ESP_OK) {
+        ESP_LOGW(TAG, "Invalid TX power %d (allowed: 8-84 in 0.25 dBm).", _portal_config.max_tx_power);
+    }
+    ESP_LOGI(TAG, "SoftAP started on channel %u, beacon interval %u TU.",
+             wifi_config.ap.channel, wifi_config.ap.beacon_interval);
 
     return ESP_OK;
 }
@@ -133,7 +702,12 @@ void WifiProvisioner::stop_ap_() {
 
 void WifiProvisioner::stop_web_server_() { 
     ESP_LOGI(TAG, "Stopping web server...");
+#if SCAN_EVENTS_AVAILABLE
+    // Der SSE-Task sendet über die Anfrage des Servers; er muss vor httpd_stop() beendet sein
+    stop_scan_events();
+#endif
     if (server_) httpd_stop(server_); 
+    server_ = nullptr;
     ESP_LOGI(TAG, "Stopping web server finished...");
 }
 
@@ -141,71 +715,479 @@ esp_err_t WifiProvisioner::start_web_server_() {
     ESP_LOGI(TAG, "Starting web server...");
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
 
-    config.max_uri_handlers = 10;    // Erlaube mehr URI-Handler (gute Praxis)
+    config.max_uri_handlers = 8 + PROBE_NUM_ROUTES;  // Eigene Routen plus ein Handler je Konnektivitäts-Check
     #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 5, 0)
     config.max_req_hdr_len  = 1024;  // Der Standardwert ist oft 512 Bytes. Wir verdoppeln ihn. Ab IDF 5.5 verfügbar:
     #endif
     config.max_resp_headers = 10;    // Erlaube mehr Response-Header (gute Praxis)
     config.uri_match_fn = httpd_uri_match_wildcard;
 
+    // Mehrere Telefone/Laptops halten jeweils mehrere Keep-Alive-Verbindungen offen. Sind alle Sockets
+    // belegt, schließt httpd mit lru_purge_enable die am längsten ungenutzte Verbindung, statt neue abzuweisen.
+    uint16_t max_sockets = _portal_config.max_open_sockets > 0 ? _portal_config.max_open_sockets : PORTAL_MAX_HTTP_SOCKETS;
+    if (max_sockets > PORTAL_MAX_HTTP_SOCKETS) {
+        ESP_LOGW(TAG, "max_open_sockets %u exceeds the lwIP limit, using %d (raise CONFIG_LWIP_MAX_SOCKETS)",
+                 max_sockets, PORTAL_MAX_HTTP_SOCKETS);
+        max_sockets = PORTAL_MAX_HTTP_SOCKETS;
+    }
+    config.max_open_sockets = max_sockets;
+    config.lru_purge_enable = _portal_config.lru_purge_enable;
+    ESP_LOGI(TAG, "Web server: %u sockets, LRU purge %s", max_sockets, config.lru_purge_enable ? "on" : "off");
+
+    memset(s_probe_hits, 0, sizeof(s_probe_hits));
+    s_portal_start = xTaskGetTickCount();
+
     if (httpd_start(&server_, &config) != ESP_OK) return ESP_FAIL;
+
+    // Konnektivitäts-Checks zuerst: exakte Pfade, kein Durchlauf der Asset-Tabelle
+    for (const probe_route_t& route : PROBE_ROUTES) {
+        httpd_uri_t probe_uri = { route.path, HTTP_GET, probe_get_handler_, (void *)&route };
+        httpd_register_uri_handler(server_, &probe_uri);
+    }
     
-    httpd_uri_t root_uri = { "/", HTTP_GET, root_get_handler_, this };
-    httpd_uri_t style_uri = { "/style.css", HTTP_GET, style_get_handler_, this };
     httpd_uri_t scan_uri = { "/scan.json", HTTP_GET, scan_get_handler_, this };
+#if SCAN_EVENTS_AVAILABLE
+    httpd_uri_t scan_events_uri = { "/scan/events", HTTP_GET, scan_events_handler_, this };
+#endif
     httpd_uri_t save_uri = { "/save", HTTP_POST, save_post_handler_, this };
-    httpd_uri_t captive_uri = { "/*", HTTP_GET, captive_portal_handler_, this };
+    httpd_uri_t status_uri = { "/status", HTTP_GET, status_get_handler_, this };
+    httpd_uri_t tz_uri = { TZ_URI_PREFIX "*", HTTP_GET, tz_get_handler_, this };
+    httpd_uri_t captive_api_uri = { CAPTIVE_API_URI, HTTP_GET, captive_api_get_handler_, this };
+    // Seiten, Stylesheet und die Captive-Portal-Umleitung teilen sich einen Handler (muss zuletzt stehen)
+    httpd_uri_t asset_uri = { "/*", HTTP_GET, asset_get_handler_, this };
     
-    httpd_register_uri_handler(server_, &root_uri);
-    httpd_register_uri_handler(server_, &style_uri);
     httpd_register_uri_handler(server_, &scan_uri);
+#if SCAN_EVENTS_AVAILABLE
+    httpd_register_uri_handler(server_, &scan_events_uri);
+#endif
     httpd_register_uri_handler(server_, &save_uri);
-    httpd_register_uri_handler(server_, &captive_uri);
+    httpd_register_uri_handler(server_, &status_uri);
+    httpd_register_uri_handler(server_, &tz_uri);
+    httpd_register_uri_handler(server_, &captive_api_uri);
+    httpd_register_uri_handler(server_, &asset_uri);
 
-    ESP_LOGI(TAG, "Starting web server finished...");
+    ESP_LOGI(TAG, "Starting web server finished, portal at %s", s_portal_url);
 
     return ESP_OK;
 }
 
 // Öffentliche Methoden
 esp_err_t WifiProvisioner::start_provisioning(const std::string& ap_ssid, bool persistent_storage, const std::string& ap_password) {
+    esp_err_t err = start_provisioning_async(ap_ssid, persistent_storage, ap_password);
+    if (err != ESP_OK) return err;
+    return wait_provisioning(portMAX_DELAY);
+}
+
+esp_err_t WifiProvisioner::start_provisioning_async(const std::string& ap_ssid, bool persistent_storage,
+                                                    const std::string& ap_password, provisioning_callback_t on_complete,
+                                                    uint32_t timeout_ms) {
+    if (_provisioning_task != nullptr) {
+        ESP_LOGE(TAG, "Provisioning is already running.");
+        return ESP_ERR_INVALID_STATE;
+    }
     _persistent_storage = persistent_storage;
+    _on_provisioning_complete = std::move(on_complete);
+    _provisioning_timeout_ms = timeout_ms;
+    _provisioning_result = ESP_ERR_INVALID_STATE;
+    _validation_state = VALIDATION_IDLE;
+    _portal_active = true;
+    xEventGroupClearBits(_provisioning_event_group, PROV_SUCCESS_BIT | PROV_CANCEL_BIT | PROV_DONE_BIT);
+    // Die Zeiten dieses Starts enthalten die Eingabe des Benutzers und zählen nicht für die Auswertung
+    boot_timing_set_flags(BOOT_TIMING_FLAG_PROVISIONING);
 
     ESP_LOGI(TAG, "Starting provisioning mode...");
-    ESP_ERROR_CHECK(start_ap_(ap_ssid, ap_password));
-    start_dns_server();
-    ESP_ERROR_CHECK(start_web_server_());
+    // Kanal-Scan, AP und Server startet der Task; der Aufrufer wartet nicht auf den Scan
+    _ap_ssid = ap_ssid;
+    _ap_password = ap_password;
+    if (xTaskCreate(provisioning_task_, "prov_wait", PROV_TASK_STACK_SIZE, this, PROV_TASK_PRIORITY,
+                    &_provisioning_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create provisioning task");
+        _provisioning_task = nullptr;
+        _portal_active = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Wählt den Kanal, startet AP, Scanner, DNS- und Webserver (im Provisionierungs-Task).
+ */
+esp_err_t WifiProvisioner::start_provisioning_services_() {
+    // Kanal: fest vorgegeben oder der am wenigsten belegte. Der Scan läuft, bevor der eigene Access
+    // Point sendet, und füllt zugleich die Netzwerkliste der Seite.
+    uint8_t channel = _portal_config.channel;
+    if (channel == 0) {
+        ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+        ESP_ERROR_CHECK(esp_wifi_start());
+        if (wifi_scanner_prescan(&channel) != ESP_OK) {
+            ESP_LOGW(TAG, "Channel scan failed. The SoftAP uses the driver's default channel.");
+        }
+        ESP_ERROR_CHECK(esp_wifi_stop());
+    }
+    ESP_ERROR_CHECK(start_ap_(_ap_ssid, _ap_password, channel));
 
+    // Die Netzwerkliste stammt zunächst aus dem Kanal-Scan, sonst läuft der erste Scan, während sich das
+    // Telefon mit dem AP verbindet
+    if (start_wifi_scanner() != ESP_OK) {
+        ESP_LOGW(TAG, "WiFi scanner could not be started. The network list will stay empty.");
+    }
+    if (start_dns_server() != ESP_OK) {
+        ESP_LOGW(TAG, "DNS server could not be started. Captive portal detection will not work.");
+    }
+    esp_err_t err = start_web_server_();
+    if (err != ESP_OK) {
+        return err;
+    }
     ESP_LOGI(TAG, "Provisioning running. Waiting for user to submit credentials...");
-    
-    // Warte hier, bis der save_post_handler das PROV_SUCCESS_BIT setzt
-    xEventGroupWaitBits(_provisioning_event_group, PROV_SUCCESS_BIT,
-                        pdTRUE, // Bit nach dem Warten löschen
-                        pdFALSE,
-                        portMAX_DELAY);
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "Credentials received. Shutting down provisioning services.");
-    
-    // Aufräumen: Server und AP stoppen
+esp_err_t WifiProvisioner::wait_provisioning(TickType_t timeout) {
+    if (_provisioning_task == nullptr && !(xEventGroupGetBits(_provisioning_event_group) & PROV_DONE_BIT)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    EventBits_t bits = xEventGroupWaitBits(_provisioning_event_group, PROV_DONE_BIT,
+                                           pdFALSE, // Bit bleibt gesetzt, weitere Aufrufe liefern dasselbe Ergebnis
+                                           pdFALSE,
+                                           timeout);
+    return (bits & PROV_DONE_BIT) ? _provisioning_result : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t WifiProvisioner::cancel_provisioning() {
+    if (_provisioning_task == nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xEventGroupSetBits(_provisioning_event_group, PROV_CANCEL_BIT);
+    xEventGroupWaitBits(_provisioning_event_group, PROV_DONE_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    return ESP_OK;
+}
+
+bool WifiProvisioner::is_provisioning() const {
+    return _provisioning_task != nullptr;
+}
+
+void WifiProvisioner::stop_provisioning_services_() {
     stop_dns_server();
     stop_web_server_();
+    stop_wifi_scanner();
     stop_ap_();
+}
 
-    return ESP_OK;
+void WifiProvisioner::provisioning_task_(void *arg) {
+    auto* provisioner = static_cast<WifiProvisioner*>(arg);
+    TickType_t timeout = provisioner->_provisioning_timeout_ms > 0 ? pdMS_TO_TICKS(provisioner->_provisioning_timeout_ms)
+                                                                   : portMAX_DELAY;
+
+    esp_err_t result = provisioner->start_provisioning_services_();
+
+    // Warte, bis der save_post_handler das PROV_SUCCESS_BIT setzt, abgebrochen wird oder die Zeit abläuft
+    EventBits_t bits = 0;
+    if (result == ESP_OK) {
+        bits = xEventGroupWaitBits(provisioner->_provisioning_event_group, PROV_SUCCESS_BIT | PROV_CANCEL_BIT,
+                                   pdTRUE, // Bits nach dem Warten löschen
+                                   pdFALSE,
+                                   timeout);
+    }
+    if (result != ESP_OK) {
+        // Das Ergebnis geht wie sonst an Callback und wait_provisioning()
+        ESP_LOGE(TAG, "Failed to start provisioning (%s). Shutting down provisioning services.", esp_err_to_name(result));
+    } else if (bits & PROV_SUCCESS_BIT) {
+        // Der Seite Zeit geben, das Ergebnis über /status abzuholen (ein Abbruch beendet sofort)
+        xEventGroupWaitBits(provisioner->_provisioning_event_group, PROV_CANCEL_BIT, pdTRUE, pdFALSE,
+                            pdMS_TO_TICKS(VALIDATION_RESULT_HOLD_MS));
+        ESP_LOGI(TAG, "Credentials verified. Shutting down provisioning services.");
+        // Wenn das `persistent_storage`-Flag gesetzt wurde, speichere die Daten erst jetzt dauerhaft im NVS
+        if (provisioner->_persistent_storage) {
+            if (provisioner->save_credentials_to_nvs_() == ESP_OK) {
+                ESP_LOGI(TAG, "Credentials also saved persistently to NVS.");
+            } else {
+                ESP_LOGE(TAG, "Failed to save credentials to NVS!");
+            }
+        }
+        result = ESP_OK;
+    } else if (bits & PROV_CANCEL_BIT) {
+        ESP_LOGI(TAG, "Provisioning cancelled. Shutting down provisioning services.");
+        result = ESP_FAIL;
+    } else {
+        ESP_LOGW(TAG, "Provisioning timed out. Shutting down provisioning services.");
+        result = ESP_ERR_TIMEOUT;
+    }
+
+    // Aufräumen: Server und AP stoppen
+    provisioner->stop_provisioning_services_();
+    provisioner->_portal_active = false;
+    esp_timer_stop(provisioner->_validation_timer);
+    provisioner->_validation_state = VALIDATION_IDLE;
+
+    provisioning_callback_t on_complete = std::move(provisioner->_on_provisioning_complete);
+    provisioner->_on_provisioning_complete = nullptr;
+    provisioner->_provisioning_result = result;
+    provisioner->_provisioning_task = nullptr;
+    xEventGroupSetBits(provisioner->_provisioning_event_group, PROV_DONE_BIT);
+
+    // Der Callback läuft in diesem Task; er darf connect_sta() aufrufen oder die Provisionierung neu starten
+    if (on_complete) on_complete(result);
+    vTaskDelete(NULL);
+}
+
+void WifiProvisioner::set_portal_config(const wifi_portal_config_t& config) {
+    _portal_config = config;
 }
 
 bool WifiProvisioner::is_provisioned() {
-    nvs_handle_t h;
-    if(nvs_open(PROV_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return false;
-    size_t s=0;
-    bool k = nvs_get_str(h, "ssid", NULL, &s) == ESP_OK && s > 1;
-    nvs_close(h);
-    return k;
+    return load_record(&s_record) == ESP_OK && s_record.num_networks > 0;
 }
 
 esp_err_t WifiProvisioner::get_credentials() {
     ESP_LOGI(TAG, "Loading credentials from NVS into class...");
-    return load_credentials_from_nvs_(_ssid, _password, _timezone);
+    esp_err_t err = load_credentials_from_nvs_(_ssid, _password, _timezone);
+    // Bei mehreren Netzwerken entscheidet connect_sta() anhand eines Scans, sofern kein Hinweis vorliegt
+    _select_on_connect = err == ESP_OK && s_record.num_networks > 1;
+    return err;
+}
+
+size_t WifiProvisioner::get_networks(wifi_network_info_t *networks, size_t max_networks) {
+    if (load_record(&s_record) != ESP_OK) return 0;
+
+    size_t count = std::min<size_t>(s_record.num_networks, max_networks);
+    for (size_t i = 0; i < count; i++) {
+        const prov_network_t& network = s_record.networks[i];
+        memset(&networks[i], 0, sizeof(networks[i]));
+        strncpy(networks[i].ssid, network.ssid, sizeof(networks[i].ssid) - 1);
+        networks[i].successes = network.successes;
+        networks[i].failures = network.failures;
+        networks[i].time_to_ip_ms = network.time_to_ip_ms;
+        networks[i].consecutive_failures = network.consecutive_failures;
+    }
+    return count;
+}
+
+/**
+ * @brief Lädt die Verbindungshinweise (BSSID, Kanal, ...) der letzten erfolgreichen Verbindung aus dem NVS.
+ * @return true, wenn gültige Hinweise vorliegen; für welches Netzwerk, steht in `hint->ssid`.
+ */
+static bool load_sta_hint(sta_hint_t *hint) {
+    nvs_handle_t h;
+    if (nvs_open(PROV_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return false;
+    size_t size = sizeof(*hint);
+    bool ok = nvs_get_blob(h, STA_HINT_NVS_KEY, hint, &size) == ESP_OK && size == sizeof(*hint);
+    nvs_close(h);
+    hint->ssid[sizeof(hint->ssid) - 1] = '\0';
+    return ok && hint->channel != 0;
+}
+
+/**
+ * @brief Speichert BSSID, Kanal und Verschlüsselung des aktuell verbundenen Access Points.
+ *
+ * Geschrieben wird nur, wenn sich etwas geändert hat; bei einem Gerät, das jedes Mal denselben Access
+ * Point verwendet, entsteht also kein Flash-Schreibzugriff pro Start.
+ */
+static void save_sta_hint(const std::string& ssid) {
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) return;
+
+    sta_hint_t hint = {};
+    strncpy(hint.ssid, ssid.c_str(), sizeof(hint.ssid) - 1);
+    memcpy(hint.bssid, ap_info.bssid, sizeof(hint.bssid));
+    hint.channel = ap_info.primary;
+    hint.authmode = (uint8_t)ap_info.authmode;
+
+    sta_hint_t stored;
+    if (load_sta_hint(&stored) && memcmp(&stored, &hint, sizeof(hint)) == 0) return;
+
+    nvs_handle_t h;
+    if (nvs_open(PROV_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+    if (nvs_set_blob(h, STA_HINT_NVS_KEY, &hint, sizeof(hint)) == ESP_OK && nvs_commit(h) == ESP_OK) {
+        ESP_LOGI(TAG, "Saved fast-connect hint: channel %u, BSSID " MACSTR, hint.channel, MAC2STR(hint.bssid));
+    }
+    nvs_close(h);
+}
+
+static void erase_sta_hint() {
+    nvs_handle_t h;
+    if (nvs_open(PROV_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+    if (nvs_erase_key(h, STA_HINT_NVS_KEY) == ESP_OK) nvs_commit(h);
+    nvs_close(h);
+}
+
+/**
+ * @brief Berechnet den PMK für WPA/WPA2-Personal aus Passwort und SSID (IEEE 802.11i, Anhang H.4).
+ */
+static esp_err_t derive_pmk(const std::string& ssid, const std::string& password, uint8_t *pmk) {
+    const unsigned char *pw = (const unsigned char *)password.c_str();
+    const unsigned char *salt = (const unsigned char *)ssid.c_str();
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+    int ret = mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA1, pw, password.length(), salt, ssid.length(),
+                                            PMK_ITERATIONS, PMK_LEN, pmk);
+#else
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    int ret = mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA1), 1);
+    if (ret == 0) {
+        ret = mbedtls_pkcs5_pbkdf2_hmac(&ctx, pw, password.length(), salt, ssid.length(), PMK_ITERATIONS, PMK_LEN, pmk);
+    }
+    mbedtls_md_free(&ctx);
+#endif
+    return ret == 0 ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Kennung der Zugangsdaten, zu denen ein gespeicherter PMK gehört (CRC32 über SSID und Passwort).
+ */
+static uint32_t pmk_owner_crc(const std::string& ssid, const std::string& password) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)ssid.c_str(), ssid.length() + 1);
+    return esp_rom_crc32_le(crc, (const uint8_t *)password.c_str(), password.length());
+}
+
+/**
+ * @brief Liefert den PMK aus dem NVS oder berechnet und speichert ihn, wenn noch keiner oder einer für
+ * andere Zugangsdaten gespeichert ist.
+ *
+ * Gespeichert wird nur der PMK des zuletzt verwendeten Netzwerks; die Kennung im Blob verhindert, dass
+ * er nach einem Wechsel des Netzwerks oder des Passworts für die falschen Zugangsdaten verwendet wird.
+ */
+static esp_err_t load_or_derive_pmk(const std::string& ssid, const std::string& password, uint8_t *pmk) {
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(PROV_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    pmk_blob_t blob;
+    size_t size = sizeof(blob);
+    uint32_t owner = pmk_owner_crc(ssid, password);
+    if (nvs_get_blob(h, PMK_NVS_KEY, &blob, &size) == ESP_OK && size == sizeof(blob) && blob.owner_crc == owner) {
+        memcpy(pmk, blob.pmk, PMK_LEN);
+        nvs_close(h);
+        return ESP_OK;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    err = derive_pmk(ssid, password, pmk);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Derived PMK in %u ms. Later boots will skip this step.",
+                 (unsigned)pdTICKS_TO_MS(xTaskGetTickCount() - start));
+        blob.owner_crc = owner;
+        memcpy(blob.pmk, pmk, PMK_LEN);
+        if (nvs_set_blob(h, PMK_NVS_KEY, &blob, sizeof(blob)) != ESP_OK || nvs_commit(h) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to save PMK to NVS");
+        }
+    }
+    nvs_close(h);
+    return err;
+}
+
+/**
+ * @brief Schreibt den PMK als 64 Hex-Zeichen in das Passwortfeld; der Treiber verwendet ihn dann direkt.
+ */
+static void set_pmk_as_password(wifi_config_t *wifi_config, const uint8_t *pmk) {
+    static const char hex[] = "0123456789abcdef";
+    static_assert(sizeof(wifi_config->sta.password) == 2 * PMK_LEN, "PMK must fill the password field");
+    for (size_t i = 0; i < PMK_LEN; i++) {
+        wifi_config->sta.password[2 * i] = hex[pmk[i] >> 4];
+        wifi_config->sta.password[2 * i + 1] = hex[pmk[i] & 0x0f];
+    }
+}
+
+/**
+ * @brief Der PMK ersetzt das Passwort nur bei WPA/WPA2-Personal. WPA3 (SAE) braucht das Passwort selbst,
+ * im Übergangsmodus WPA2/WPA3 würde der PMK die Verbindung auf WPA2 herabstufen.
+ */
+static bool pmk_usable(wifi_auth_mode_t authmode, const std::string& password) {
+    bool psk = authmode == WIFI_AUTH_WPA_PSK || authmode == WIFI_AUTH_WPA2_PSK || authmode == WIFI_AUTH_WPA_WPA2_PSK;
+    // 64 Zeichen sind bereits ein PSK in Hex-Schreibweise
+    return psk && password.length() >= 8 && password.length() < 64;
+}
+
+/**
+ * @brief Bewertet ein Netzwerk für die Auswahl: Signalstärke in dBm, verschoben um den Verlauf.
+ *
+ * Eine hohe Erfolgsquote bringt bis zu SELECT_SUCCESS_WEIGHT dB, jeder Fehlversuch in Folge kostet
+ * SELECT_FAILURE_PENALTY dB, jede Sekunde bis zur IP-Adresse 1 dB. Ohne Verlauf zählt die halbe Quote.
+ */
+static int network_score(const prov_network_t& network, int8_t rssi) {
+    uint32_t attempts = network.successes + network.failures;
+    int score = rssi;
+    score += attempts > 0 ? (int)(SELECT_SUCCESS_WEIGHT * network.successes / attempts) : SELECT_SUCCESS_WEIGHT / 2;
+    score -= SELECT_FAILURE_PENALTY * std::min<int>(network.consecutive_failures, SELECT_MAX_FAILURE_PENALTIES);
+    score -= std::min<int>(network.time_to_ip_ms / 1000, SELECT_MAX_TIME_PENALTY);
+    return score;
+}
+
+/**
+ * @brief Trägt das Ergebnis eines Verbindungsversuchs in den Verlauf des Netzwerks ein.
+ *
+ * Fehlversuche bleiben zunächst im RAM und werden mit der nächsten erfolgreichen Verbindung geschrieben.
+ * Geschrieben wird nur, wenn sich dabei die Bewertung des Netzwerks (und damit ggf. die Reihenfolge der
+ * Auswahl) ändert oder vorher Fehlversuche auftraten; eine stabile Verbindung schreibt also nicht bei
+ * jedem GOT_IP in den Flash.
+ */
+static void record_attempt(const std::string& ssid, bool success, uint32_t time_to_ip_ms) {
+    int index = s_record_loaded ? find_network(s_record, ssid.c_str()) : -1;
+    if (index < 0) return;
+
+    prov_network_t& network = s_record.networks[index];
+    int score_before = network_score(network, 0);
+    bool changed = false;
+    if (network.successes + network.failures >= SELECT_HISTORY_LIMIT) {
+        network.successes /= 2;
+        network.failures /= 2;
+        changed = true;
+    }
+    if (success) {
+        changed = changed || network.consecutive_failures > 0;
+        network.successes++;
+        network.consecutive_failures = 0;
+        network.time_to_ip_ms = std::min<uint32_t>(time_to_ip_ms, UINT16_MAX);
+        changed = changed || network_score(network, 0) != score_before;
+        if (changed && store_record(&s_record) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to save network statistics");
+        }
+    } else {
+        network.failures++;
+        if (network.consecutive_failures < UINT8_MAX) network.consecutive_failures++;
+    }
+}
+
+bool WifiProvisioner::roaming_enabled_() {
+    return is_provisioned() && s_record.num_networks > 1 && find_network(s_record, _ssid.c_str()) >= 0;
+}
+
+/**
+ * @brief Erstellt die STA-Konfiguration; mit `ap` wird dieser Access Point direkt auf seinem Kanal
+ * angesprochen, ohne `ap` werden alle Kanäle nach der SSID abgesucht.
+ */
+static void build_sta_config(wifi_config_t *wifi_config, const std::string& ssid, const std::string& password,
+                             const sta_hint_t *ap) {
+    memset(wifi_config, 0, sizeof(*wifi_config));
+    // Beide Felder dürfen ohne Nullterminierung voll sein (32-Byte-SSID, 64-stelliger Hex-PSK)
+    memcpy(wifi_config->sta.ssid, ssid.c_str(), std::min(ssid.length(), sizeof(wifi_config->sta.ssid)));
+    memcpy(wifi_config->sta.password, password.c_str(), std::min(password.length(), sizeof(wifi_config->sta.password)));
+
+    if (password.length() > 0) {
+        wifi_config->sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    } else {
+        wifi_config->sta.threshold.authmode = WIFI_AUTH_OPEN;
+    }
+
+    if (ap == nullptr) {
+        wifi_config->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        return;
+    }
+
+    wifi_config->sta.bssid_set = true;
+    memcpy(wifi_config->sta.bssid, ap->bssid, sizeof(wifi_config->sta.bssid));
+    wifi_config->sta.channel = ap->channel;
+    wifi_config->sta.scan_method = WIFI_FAST_SCAN;
+    // Die bekannte Verschlüsselung als Mindestanforderung: kein Downgrade beim Direktversuch
+    wifi_config->sta.threshold.authmode = std::max(wifi_config->sta.threshold.authmode, (wifi_auth_mode_t)ap->authmode);
+
+    // Bekannter Access Point mit WPA2-Personal: den gespeicherten PMK übergeben, damit der Treiber
+    // nicht bei jedem Start 4096 PBKDF2-Runden rechnet (nur bei dauerhaft gespeicherten Zugangsdaten)
+    uint8_t pmk[PMK_LEN];
+    if (pmk_usable((wifi_auth_mode_t)ap->authmode, password) && s_record_loaded &&
+        find_network(s_record, ssid.c_str()) >= 0 && load_or_derive_pmk(ssid, password, pmk) == ESP_OK) {
+        set_pmk_as_password(wifi_config, pmk);
+        ESP_LOGI(TAG, "  -> Using cached PMK");
+    }
 }
 
 esp_err_t WifiProvisioner::connect_sta(const char* hostname) {
@@ -228,16 +1210,24 @@ esp_err_t WifiProvisioner::connect_sta(const char* hostname) {
         ESP_LOGI(TAG, "  -> Hostname set to: '%s'", hostname);
     }
 
-    // 4. WiFi-Konfiguration mit den Member-Variablen erstellen
-    wifi_config_t wifi_config = {};
-    strncpy((char*)wifi_config.sta.ssid, _ssid.c_str(), sizeof(wifi_config.sta.ssid) - 1);
-    strncpy((char*)wifi_config.sta.password, _password.c_str(), sizeof(wifi_config.sta.password) - 1);
-    
-    if (_password.length() > 0) {
-        wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
-    } else {
-        wifi_config.sta.threshold.authmode = WIFI_AUTH_OPEN;
+    // 4. WiFi-Konfiguration mit den Member-Variablen erstellen. Ist der Access Point der letzten Verbindung
+    // bekannt, wird er direkt auf seinem Kanal angesprochen, statt vorher alle Kanäle zu scannen.
+    // Schlägt das fehl, folgt ein normaler Scan.
+    sta_hint_t hint;
+    s_directed_connect = load_sta_hint(&hint) && strncmp(hint.ssid, _ssid.c_str(), sizeof(hint.ssid)) == 0;
+    s_connected_before = s_directed_connect;
+    if (s_directed_connect) {
+        ESP_LOGI(TAG, "  -> Fast connect: channel %u, BSSID " MACSTR, hint.channel, MAC2STR(hint.bssid));
+    }
+    wifi_config_t wifi_config;
+    build_sta_config(&wifi_config, _ssid, _password, s_directed_connect ? &hint : nullptr);
+
+    // 4a. Mehrere gespeicherte Netzwerke und kein Hinweis: beim Start erst scannen und das beste wählen
+    s_select_on_start = !s_directed_connect && _select_on_connect && roaming_enabled_();
+    if (s_select_on_start) {
+        ESP_LOGI(TAG, "  -> %u known networks, selecting the best one after a scan", s_record.num_networks);
     }
+    s_connect_start = xTaskGetTickCount();
     
     // 5. WiFi-System starten (der eigentliche Verbindungsaufbau geschieht im Event-Handler)
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
@@ -253,144 +1243,637 @@ esp_err_t WifiProvisioner::connect_sta(const char* hostname) {
     return ESP_OK;
 }
 
+void WifiProvisioner::select_network_() {
+    s_select_scan = false;
+
+    // Statisch, um den Stack des Event-Loop-Tasks zu schonen
+    static wifi_ap_record_t records[SELECT_MAX_SCAN_RESULTS];
+    uint16_t count = SELECT_MAX_SCAN_RESULTS;
+    if (esp_wifi_scan_get_ap_records(&count, records) != ESP_OK) {
+        count = 0;
+    }
+
+    s_num_candidates = s_record.num_networks;
+    for (uint8_t i = 0; i < s_num_candidates; i++) {
+        select_candidate_t& candidate = s_candidates[i];
+        memset(&candidate, 0, sizeof(candidate));
+        candidate.network = i;
+        for (uint16_t j = 0; j < count; j++) {
+            const wifi_ap_record_t& ap = records[j];
+            if (strncmp((const char *)ap.ssid, s_record.networks[i].ssid, sizeof(ap.ssid)) != 0) continue;
+            if (candidate.ap.channel != 0 && ap.rssi <= candidate.rssi) continue;
+            candidate.rssi = ap.rssi;
+            memcpy(candidate.ap.ssid, s_record.networks[i].ssid, sizeof(candidate.ap.ssid));
+            memcpy(candidate.ap.bssid, ap.bssid, sizeof(candidate.ap.bssid));
+            candidate.ap.channel = ap.primary;
+            candidate.ap.authmode = (uint8_t)ap.authmode;
+        }
+        candidate.score = candidate.ap.channel != 0 ? network_score(s_record.networks[i], candidate.rssi) : INT16_MIN;
+    }
+    // Gesehene Netzwerke nach Bewertung; nicht gesehene behalten ihre Reihenfolge und kommen zuletzt
+    std::stable_sort(s_candidates, s_candidates + s_num_candidates,
+                     [](const select_candidate_t& a, const select_candidate_t& b) { return a.score > b.score; });
+
+    for (uint8_t i = 0; i < s_num_candidates; i++) {
+        const select_candidate_t& candidate = s_candidates[i];
+        if (candidate.ap.channel != 0) {
+            ESP_LOGI(TAG, "Candidate %u: '%s' rssi %d, score %d", i + 1, s_record.networks[candidate.network].ssid,
+                     candidate.rssi, candidate.score);
+        } else {
+            ESP_LOGI(TAG, "Candidate %u: '%s' not seen in scan", i + 1, s_record.networks[candidate.network].ssid);
+        }
+    }
+
+    s_candidate_pos = 0;
+    s_selecting = true;
+    connect_candidate_();
+}
+
+void WifiProvisioner::connect_candidate_() {
+    const select_candidate_t& candidate = s_candidates[s_candidate_pos];
+    const prov_network_t& network = s_record.networks[candidate.network];
+    _ssid = network.ssid;
+    _password = network.password;
+    ESP_LOGI(TAG, "Connecting to '%s'...", network.ssid);
+
+    // Im Scan gesehene Netzwerke direkt über BSSID und Kanal des stärksten Access Points ansprechen
+    wifi_config_t wifi_config;
+    build_sta_config(&wifi_config, _ssid, _password, candidate.ap.channel != 0 ? &candidate.ap : nullptr);
+    s_connect_start = xTaskGetTickCount();
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    esp_wifi_connect();
+}
+
 // NVS Handler
 esp_err_t WifiProvisioner::load_credentials_from_nvs_(std::string& ssid, std::string& password, std::string& timezone) {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(PROV_NVS_NAMESPACE, NVS_READONLY, &h);
+    esp_err_t err = load_record(&s_record);
     if (err != ESP_OK) return err;
+    if (s_record.num_networks == 0) return ESP_ERR_NVS_NOT_FOUND;
 
-    size_t required_size;
-    // SSID
-    if (nvs_get_str(h, "ssid", NULL, &required_size) == ESP_OK) {
-        ssid.resize(required_size);
-        nvs_get_str(h, "ssid", &ssid[0], &required_size); // &ssid[0] gibt ab C++11 einen schreibbaren Pointer auf den internen Puffer des Strings zurück
-        ssid.pop_back(); // NVS speichert mit \0, das entfernen wir aus dem std::string
-    }
-    // Password
-    if (nvs_get_str(h, "password", NULL, &required_size) == ESP_OK) {
-        password.resize(required_size);
-        nvs_get_str(h, "password", &password[0], &required_size);
-        password.pop_back();
-    }
-    // Timezone
-    if (nvs_get_str(h, "timezone", NULL, &required_size) == ESP_OK) {
-        timezone.resize(required_size);
-        nvs_get_str(h, "timezone", &timezone[0], &required_size);
-        timezone.pop_back();
+    // Bei mehreren Netzwerken zuerst das zuletzt verbundene, für das ein Schnellverbindungs-Hinweis vorliegt
+    int index = 0;
+    sta_hint_t hint;
+    if (s_record.num_networks > 1 && load_sta_hint(&hint)) {
+        index = std::max(0, find_network(s_record, hint.ssid));
     }
-    
-    nvs_close(h);
+
+    ssid = s_record.networks[index].ssid;
+    password = s_record.networks[index].password;
+    timezone = s_record.timezone;
     return ESP_OK;
 }
 
 esp_err_t WifiProvisioner::save_credentials_to_nvs_() {
-    nvs_handle_t nvs_handle;
-    ESP_LOGI(TAG, "Opening NVS to save credentials...");
-    esp_err_t err = nvs_open(PROV_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
-        return err;
+    prov_network_t network = {};
+    if (_ssid.length() >= sizeof(network.ssid) || _password.length() >= sizeof(network.password) ||
+        _timezone.length() >= sizeof(s_record.timezone)) {
+        ESP_LOGE(TAG, "Credentials too long for NVS record");
+        return ESP_ERR_INVALID_SIZE;
     }
 
-    // Schreibe die Werte aus den Member-Variablen in den NVS
-    err = nvs_set_str(nvs_handle, "ssid", _ssid.c_str());
-    if (err != ESP_OK) ESP_LOGE(TAG, "Failed to save ssid to NVS");
+    prov_record_t record;
+    if (load_record(&record) != ESP_OK) {
+        memset(&record, 0, sizeof(record));
+    }
 
-    err = nvs_set_str(nvs_handle, "password", _password.c_str());
-    if (err != ESP_OK) ESP_LOGE(TAG, "Failed to save password to NVS");
+    // Ein bereits bekanntes Netzwerk behält seinen Verlauf, solange das Passwort gleich bleibt
+    int index = find_network(record, _ssid.c_str());
+    if (index >= 0 && strncmp(record.networks[index].password, _password.c_str(), sizeof(network.password)) == 0) {
+        network = record.networks[index];
+    } else {
+        strncpy(network.ssid, _ssid.c_str(), sizeof(network.ssid) - 1);
+        strncpy(network.password, _password.c_str(), sizeof(network.password) - 1);
+    }
 
-    err = nvs_set_str(nvs_handle, "timezone", _timezone.c_str());
-    if (err != ESP_OK) ESP_LOGE(TAG, "Failed to save timezone to NVS");
-    
-    // Bestätige die Schreibvorgänge
-    err = nvs_commit(nvs_handle);
+    // Liste voll: das Netzwerk mit dem schlechtesten Verlauf (bei Gleichstand das älteste) ersetzen
+    if (index < 0 && record.num_networks == WIFI_PROV_MAX_NETWORKS) {
+        index = 0;
+        for (uint8_t i = 1; i < record.num_networks; i++) {
+            if (network_score(record.networks[i], 0) <= network_score(record.networks[index], 0)) index = i;
+        }
+        ESP_LOGI(TAG, "Network list full, replacing '%s'", record.networks[index].ssid);
+    }
+    if (index < 0) {
+        index = record.num_networks++;
+    }
+
+    // Das neue Netzwerk kommt nach vorne, die davor stehenden rücken eine Stelle nach hinten
+    memmove(&record.networks[1], &record.networks[0], index * sizeof(prov_network_t));
+    record.networks[0] = network;
+    memset(record.timezone, 0, sizeof(record.timezone));
+    strncpy(record.timezone, _timezone.c_str(), sizeof(record.timezone) - 1);
+
+    // Ein einziger Schreibvorgang für alle Werte
+    ESP_LOGI(TAG, "Saving credentials to NVS...");
+    esp_err_t err = store_record(&record);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit credentials to NVS");
+        ESP_LOGE(TAG, "Failed to commit credentials to NVS (%s)", esp_err_to_name(err));
     } else {
-        ESP_LOGI(TAG, "Credentials successfully committed to NVS.");
+        ESP_LOGI(TAG, "Credentials successfully committed to NVS (%u known networks).", record.num_networks);
     }
-    
-    // Schließe den NVS-Handle
-    nvs_close(nvs_handle);
     return err;
 }
 
+esp_err_t WifiProvisioner::remove_network(const std::string& ssid) {
+    prov_record_t record;
+    esp_err_t err = load_record(&record);
+    if (err != ESP_OK) return err;
+
+    int index = find_network(record, ssid.c_str());
+    if (index < 0) return ESP_ERR_NOT_FOUND;
+    if (record.num_networks == 1) {
+        erase_credentials_from_nvs();
+        return ESP_OK;
+    }
+
+    memmove(&record.networks[index], &record.networks[index + 1],
+            (record.num_networks - index - 1) * sizeof(prov_network_t));
+    record.num_networks--;
+    memset(&record.networks[record.num_networks], 0, sizeof(prov_network_t));
+
+    sta_hint_t hint;
+    if (load_sta_hint(&hint) && strncmp(hint.ssid, ssid.c_str(), sizeof(hint.ssid)) == 0) {
+        erase_sta_hint();
+    }
+    return store_record(&record);
+}
+
+/**
+ * @brief Prüft, ob der Client gzip in `Accept-Encoding` angibt.
+ *
+ * Es gibt bewusst keine unkomprimierte Variante im Flash: Alle Browser und Captive-Portal-Fenster
+ * (Android, iOS/macOS, Windows, Firefox, NetworkManager) senden "gzip" und können es dekodieren. Ein
+ * Client ohne gzip erhält die Datei trotzdem komprimiert; die Warnung zeigt solche Fälle im Log.
+ */
+static bool accepts_gzip(httpd_req_t *req) {
+    char header[64];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "Accept-Encoding", header, sizeof(header));
+    // Ein abgeschnittener Header enthält gzip fast immer in den ersten Einträgen
+    if ((err == ESP_OK || err == ESP_ERR_HTTPD_RESULT_TRUNC) && strstr(header, "gzip") != nullptr) {
+        return true;
+    }
+    ESP_LOGW(TAG, "Client does not accept gzip for %s, sending it compressed anyway", req->uri);
+    return false;
+}
+
+/**
+ * @brief Sendet eine eingebettete, gzip-komprimierte Datei mit ETag und Cache-Headern.
+ *
+ * Die Daten werden direkt aus dem Flash gesendet, ohne sie vorher zu kopieren. Schickt der Browser
+ * den aktuellen ETag in `If-None-Match` mit, wird nur "304 Not Modified" gesendet. Zu Clients ohne
+ * gzip siehe accepts_gzip().
+ */
+static esp_err_t send_compressed_asset(httpd_req_t *req, const web_asset_t& asset) {
+    httpd_resp_set_hdr(req, "ETag", asset.etag);
+    httpd_resp_set_hdr(req, "Cache-Control", asset.revalidate ? CACHE_CONTROL_HTML : CACHE_CONTROL_IMMUTABLE);
+
+    char if_none_match[64];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strstr(if_none_match, asset.etag) != nullptr) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    accepts_gzip(req);
+    httpd_resp_set_type(req, asset.mime);
+    httpd_resp_set_hdr(req, "Content-Encoding", asset.encoding);
+    return httpd_resp_send(req, (const char *)asset.start, asset.end - asset.start);
+}
+
+// Primärer Sprach-Subtag ("de" aus "de-AT") -> Index in WEB_LANGS + 1 (0 = nicht unterstützt)
+#define LANG_TABLE_SIZE (26 * 26)
+
+static constexpr size_t lang_key(char a, char b) {
+    return (size_t)((a | 0x20) - 'a') * 26 + (size_t)((b | 0x20) - 'a');
+}
+
+static constexpr std::array<uint8_t, LANG_TABLE_SIZE> make_lang_table() {
+    std::array<uint8_t, LANG_TABLE_SIZE> table{};
+    for (size_t i = 0; i < WEB_NUM_LANGS; i++) table[lang_key(WEB_LANGS[i][0], WEB_LANGS[i][1])] = (uint8_t)(i + 1);
+    return table;
+}
+
+static constexpr std::array<uint8_t, LANG_TABLE_SIZE> s_lang_table = make_lang_table();
+
+static bool is_ascii_alpha(char c) {
+    return (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+}
+
+/**
+ * @brief Wählt die Sprache anhand des Accept-Language-Headers (z.B. "de-AT,de;q=0.9,en;q=0.8").
+ *
+ * Jeder Eintrag wird über seinen zweibuchstabigen Sprach-Subtag direkt in der Tabelle nachgeschlagen;
+ * gewählt wird der unterstützte Eintrag mit dem höchsten q-Wert.
+ * @return Index in WEB_LANGS, ohne passenden Eintrag 0 (Standard-Sprache).
+ */
+static size_t select_language(httpd_req_t *req) {
+    char header[128];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "Accept-Language", header, sizeof(header));
+    if (err != ESP_OK && err != ESP_ERR_HTTPD_RESULT_TRUNC) return 0;
+
+    size_t best = 0;
+    int best_q = 0; // q-Wert in Tausendsteln
+    for (const char *p = header; *p; ) {
+        while (*p == ' ' || *p == ',') p++;
+        const char *tag = p;
+        while (*p && *p != ',' && *p != ';') p++;
+
+        int q = 1000;
+        const char *param = strstr(p, ";q=");
+        const char *next = strchr(p, ',');
+        if (param != nullptr && (next == nullptr || param < next)) {
+            const char *v = param + 3;
+            q = (*v == '1') ? 1000 : 0;
+            if (v[0] == '0' && v[1] == '.') {
+                int scale = 100;
+                for (v += 2; *v >= '0' && *v <= '9' && scale > 0; v++, scale /= 10) q += (*v - '0') * scale;
+            }
+        }
+
+        bool two_letters = p - tag >= 2 && is_ascii_alpha(tag[0]) && is_ascii_alpha(tag[1]) &&
+                           (p - tag == 2 || tag[2] == '-');
+        uint8_t slot = two_letters ? s_lang_table[lang_key(tag[0], tag[1])] : 0;
+        if (slot != 0 && q > best_q) {
+            best = slot - 1;
+            best_q = q;
+        }
+        p = next ? next : p + strlen(p);
+    }
+    return best;
+}
+
+/**
+ * @brief Vergleicht einen nicht nullterminierten Namen mit einem C-String (strcmp-Reihenfolge).
+ */
+static int compare_name(const char *name, size_t len, const char *other) {
+    int cmp = strncmp(name, other, len);
+    if (cmp != 0) return cmp;
+    return other[len] == '\0' ? 0 : -1;
+}
+
+/**
+ * @brief Binäre Suche in einem alphabetisch sortierten Array über das Feld `key`.
+ */
+template <typename T, typename Key>
+static const T *find_sorted(const T *items, size_t count, const char *name, size_t len, Key key) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = compare_name(name, len, key(items[mid]));
+        if (cmp == 0) return &items[mid];
+        if (cmp < 0) hi = mid; else lo = mid + 1;
+    }
+    return nullptr;
+}
+
 // HTTP Handler
-esp_err_t WifiProvisioner::root_get_handler_(httpd_req_t *r) { 
-    httpd_resp_set_type(r, "text/html"); 
-    return httpd_resp_send(r, root_html_start, root_html_end - root_html_start); 
+/**
+ * @brief Liefert alle eingebetteten Web-Dateien aus WEB_ROUTES aus.
+ *
+ * Gibt es eine Seite in mehreren Sprachen, entscheidet der Accept-Language-Header. Unbekannte Pfade
+ * werden auf das Captive Portal umgeleitet.
+ */
+esp_err_t WifiProvisioner::asset_get_handler_(httpd_req_t *req) {
+    size_t path_len = strcspn(req->uri, "?#");
+    for (const web_route_t& route : WEB_ROUTES) {
+        if (compare_name(req->uri, path_len, route.path) != 0) continue;
+
+        bool localized = false;
+        for (size_t i = 1; i < WEB_NUM_LANGS; i++) localized |= route.variants[i] != route.variants[0];
+        if (!localized) {
+            return send_compressed_asset(req, *route.variants[0]);
+        }
+        // Caches dürfen die Seite nur für dieselbe Sprachauswahl wiederverwenden
+        httpd_resp_set_hdr(req, "Vary", "Accept-Language");
+        return send_compressed_asset(req, *route.variants[select_language(req)]);
+    }
+    return captive_portal_handler_(req);
 }
-esp_err_t WifiProvisioner::style_get_handler_(httpd_req_t *r) { 
-    httpd_resp_set_type(r, "text/css"); 
-    return httpd_resp_send(r, style_css_start, style_css_end - style_css_start); 
+
+/**
+ * @brief Liefert die Zeitzonen-Datenbank in Teilen aus.
+ *
+ * - `/tz/`                   Liste der Regionen
+ * - `/tz/<Region>`           Städte der Region mit POSIX-String ([["Vienna","CET-1CEST,..."], ...])
+ * - `/tz/<Region>/<Stadt>`   Auflösung einer IANA-Zone, z.B. `/tz/Europe/Vienna`
+ */
+esp_err_t WifiProvisioner::tz_get_handler_(httpd_req_t *req) {
+    const char *path = req->uri + strlen(TZ_URI_PREFIX);
+    size_t path_len = strcspn(path, "?#");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", CACHE_CONTROL_TZ);
+
+    if (path_len == 0) {
+        return httpd_resp_send(req, TZ_REGIONS_JSON, sizeof(TZ_REGIONS_JSON) - 1);
+    }
+
+    const char *slash = (const char *)memchr(path, '/', path_len);
+    size_t region_len = slash ? (size_t)(slash - path) : path_len;
+    const tz_region_t *region = find_sorted(TZ_REGIONS, TZ_NUM_REGIONS, path, region_len,
+                                            [](const tz_region_t& r) { return r.name; });
+    if (region == nullptr) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown region");
+    }
+
+    if (slash == nullptr) {
+        accepts_gzip(req);
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        return httpd_resp_send(req, (const char *)region->json_gz, region->json_gz_len);
+    }
+
+    const char *city = slash + 1;
+    size_t city_len = path_len - region_len - 1;
+    const tz_zone_t *zone = find_sorted(region->zones, region->num_zones, city, city_len,
+                                        [](const tz_zone_t& z) { return z.city; });
+    if (zone == nullptr) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown timezone");
+    }
+
+    char json[160];
+    int len = snprintf(json, sizeof(json), "{\"region\":\"%s\",\"city\":\"%s\",\"posix\":\"%s\"}",
+                       region->name, zone->city, TZ_POSIX[zone->posix]);
+    return httpd_resp_send(req, json, len);
 }
+
 esp_err_t WifiProvisioner::captive_portal_handler_(httpd_req_t *r) { 
     httpd_resp_set_status(r, "302 Found"); 
-    httpd_resp_set_hdr(r, "Location", "http://192.168.4.1"); 
+    httpd_resp_set_hdr(r, "Location", s_portal_url); 
     return httpd_resp_send(r, NULL, 0); 
 }
 
+/**
+ * @brief Captive-Portal-API nach RFC 8908: Das Gerät ist hinter einem Portal, das unter `user-portal-url` liegt.
+ * @note Abweichend von RFC 8908 nur über HTTP erreichbar (siehe CAPTIVE_API_URI).
+ */
+esp_err_t WifiProvisioner::captive_api_get_handler_(httpd_req_t *req) {
+    char json[96];
+    int len = snprintf(json, sizeof(json), "{\"captive\":true,\"user-portal-url\":\"%s\"}", s_portal_url);
+    httpd_resp_set_type(req, "application/captive+json");
+    httpd_resp_set_hdr(req, "Cache-Control", "private, no-store");
+    return httpd_resp_send(req, json, len);
+}
+
+/**
+ * @brief Beantwortet den Konnektivitäts-Check eines Betriebssystems mit einer Umleitung auf das Portal.
+ */
+esp_err_t WifiProvisioner::probe_get_handler_(httpd_req_t *req) {
+    const probe_route_t *route = static_cast<const probe_route_t *>(req->user_ctx);
+    if (s_probe_hits[route->family]++ == 0) {
+        ESP_LOGI(TAG, "First %s connectivity check (%s) %u ms after portal start", s_probe_family_names[route->family],
+                 route->path, (unsigned)pdTICKS_TO_MS(xTaskGetTickCount() - s_portal_start));
+    }
+    return captive_portal_handler_(req);
+}
+
+// Puffer für die gestreamte Scan-Antwort. Ein Eintrag braucht höchstens ~260 Bytes
+// (32 Zeichen SSID, jedes im schlimmsten Fall als \u00XX maskiert).
+#define SCAN_JSON_CHUNK_SIZE 512
+#define SCAN_JSON_MAX_ENTRY_LEN 260
+
+/**
+ * @brief Puffer für eine JSON-Antwort, die in Teilen mit httpd_resp_send_chunk gesendet wird.
+ */
+struct json_chunk_writer_t {
+    httpd_req_t *req;
+    char buf[SCAN_JSON_CHUNK_SIZE];
+    size_t len;
+    esp_err_t err;
+};
+
+static void json_flush(json_chunk_writer_t *w) {
+    if (w->len > 0 && w->err == ESP_OK) {
+        w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+    }
+    w->len = 0;
+}
+
+static void json_append(json_chunk_writer_t *w, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, args);
+    va_end(args);
+    if (n > 0) w->len = std::min(w->len + (size_t)n, sizeof(w->buf) - 1);
+}
+
+/**
+ * @brief Hängt einen String als JSON-String an (Anführungszeichen, Backslash und Steuerzeichen maskiert).
+ */
+static void json_append_string(json_chunk_writer_t *w, const char *str) {
+    static const char hex[] = "0123456789abcdef";
+    char *out = w->buf + w->len;
+    *out++ = '"';
+    for (const uint8_t *p = (const uint8_t *)str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            *out++ = '\\';
+            *out++ = (char)*p;
+        } else if (*p < 0x20) {
+            memcpy(out, "\\u00", 4);
+            out[4] = hex[*p >> 4];
+            out[5] = hex[*p & 0x0F];
+            out += 6;
+        } else {
+            *out++ = (char)*p;
+        }
+    }
+    *out++ = '"';
+    w->len = out - w->buf;
+}
+
+/**
+ * @brief Hängt ein Netzwerk als JSON-Objekt an; sendet vorher den Puffer, falls er zu voll ist.
+ */
+static void json_append_entry(json_chunk_writer_t *w, const wifi_scan_entry_t& entry) {
+    if (sizeof(w->buf) - w->len < SCAN_JSON_MAX_ENTRY_LEN) json_flush(w);
+    json_append(w, "{\"ssid\":");
+    json_append_string(w, entry.ssid);
+    json_append(w, ",\"rssi\":%d,\"ch\":%u,\"auth\":%d}", entry.rssi, entry.channel, (int)entry.authmode);
+}
+
+static int scan_age_s(const wifi_scan_info_t& info) {
+    return info.age_ms == WIFI_SCAN_AGE_NONE ? -1 : (int)(info.age_ms / 1000);
+}
+
+// Zwischenspeicher für die Ergebnisse; die Handler laufen alle im selben httpd-Task
+static wifi_scan_entry_t s_scan_entries[WIFI_SCAN_MAX_NETWORKS];
+
+/**
+ * @brief Liefert die Ergebnisse des Hintergrund-Scans, ohne auf einen Scan zu warten.
+ *
+ * Antwort: `{"aps":[{"ssid":"..","rssi":-49,"ch":6,"auth":3},..],"age":3,"scanning":false}`.
+ * Jede SSID erscheint nur einmal (stärkster Access Point). `age` ist das Alter der Ergebnisse in
+ * Sekunden (-1, solange noch kein Scan abgeschlossen ist). Bei `scanning` läuft gerade ein Scan und die
+ * Seite fragt kurz darauf erneut. `/scan.json?refresh=1` erzwingt einen neuen Scan.
+ *
+ * Das JSON wird ohne Heap-Speicher in einem festen Puffer aufgebaut und in Teilen gesendet.
+ */
 esp_err_t WifiProvisioner::scan_get_handler_(httpd_req_t *req) {
+    char query[16];
+    bool refresh = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK && strstr(query, "refresh=1") != nullptr;
 
-    // 1. WLAN-Scan durchführen
-    uint16_t num_aps = 0;
-    // esp_wifi_scan_stop(); // Stoppt einen evtl. laufenden Scan
-    esp_wifi_scan_start(NULL, true); // true = blockierend, wartet auf das Ergebnis
-    esp_wifi_scan_get_ap_num(&num_aps);
-    
-    ESP_LOGI(TAG, "==> Scan beendet. Gefundene Netzwerke: %u", num_aps);
+    size_t num_entries = 0;
+    wifi_scan_info_t info = wifi_scanner_get_results(s_scan_entries, WIFI_SCAN_MAX_NETWORKS, &num_entries,
+                                                     refresh ? 0 : WIFI_SCAN_MAX_AGE_MS);
+    ESP_LOGD(TAG, "==> Sende %u Netzwerke an den Browser", (unsigned)num_entries);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
 
-    if (num_aps == 0) {
-        ESP_LOGW(TAG, "Keine Netzwerke gefunden. Sende leere JSON-Liste.");
-        httpd_resp_set_type(req, "application/json");
-        return httpd_resp_send(req, "{\"aps\":[]}", HTTPD_RESP_USE_STRLEN);
+    json_chunk_writer_t writer = { req, {}, 0, ESP_OK };
+    json_append(&writer, "{\"aps\":[");
+    for (size_t i = 0; i < num_entries; i++) {
+        if (i > 0) json_append(&writer, ",");
+        json_append_entry(&writer, s_scan_entries[i]);
     }
-    
-    std::vector<wifi_ap_record_t> ap_records(num_aps);
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&num_aps, ap_records.data()));
+    json_append(&writer, "],\"age\":%d,\"scanning\":%s}", scan_age_s(info), info.scanning ? "true" : "false");
+    json_flush(&writer);
+
+    if (writer.err != ESP_OK) {
+        return writer.err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0); // Ende der Antwort
+}
 
-    // 2. Liste  sortieren
-    std::sort(ap_records.begin(), ap_records.end(), [](const wifi_ap_record_t& a, const wifi_ap_record_t& b) {
-        // alphabetische Sortierung:
-        // return strcmp((const char*)a.ssid, (const char*)b.ssid) < 0;
 
-        // Sortierung nach RSSI (absteigend, da höhere Werte besser sind):
-        return a.rssi > b.rssi;
-    });
+#if SCAN_EVENTS_AVAILABLE
+// Ein Stream pro Verbindungsversuch: höchstens so lange, wie ein Durchlauf über alle Kanäle dauert
+#define SCAN_EVENTS_TIMEOUT_MS 10000
+#define SCAN_EVENTS_WAIT_MS 500
+#define SCAN_EVENTS_TASK_STACK_SIZE 4096
+#define SCAN_EVENTS_TASK_PRIORITY 5
+// Obergrenze für das Ende des Tasks: ein laufendes Warten plus ein blockiertes Senden (Send-Timeout
+// des httpd, Standard 5 s)
+#define SCAN_EVENTS_STOP_TIMEOUT_MS (SCAN_EVENTS_WAIT_MS + 6000)
 
-    // 3. JSON aus der sortierten Liste erstellen
-    cJSON *root = cJSON_CreateObject();
-    cJSON *aps = cJSON_CreateArray();
-    cJSON_AddItemToObject(root, "aps", aps);
+// Bits für die Event Group
+#define SCAN_EVENTS_STOP_BIT BIT0
+#define SCAN_EVENTS_DONE_BIT BIT1
+
+// Der Stream läuft in einem eigenen Task; es gibt immer nur einen gleichzeitig
+static wifi_scan_entry_t s_event_entries[WIFI_SCAN_MAX_NETWORKS];
+static volatile bool s_scan_events_active = false;
+static EventGroupHandle_t s_scan_events_group = nullptr;
+
+/**
+ * @brief Sendet neu gefundene Netzwerke als Server-Sent Events, bis der laufende Durchlauf fertig ist.
+ *
+ * Pro Netzwerk ein Event `ap` (JSON wie in /scan.json), zum Schluss ein Event `done` mit dem Alter der
+ * Ergebnisse. Läuft kein Scan, werden die vorhandenen Ergebnisse gesendet und der Stream sofort beendet.
+ */
+static void scan_events_task(void *arg) {
+    httpd_req_t *req = (httpd_req_t *)arg;
+    json_chunk_writer_t writer = { req, {}, 0, ESP_OK };
+    uint32_t seq = 0;
+    TickType_t start = xTaskGetTickCount();
+
+    while (writer.err == ESP_OK) {
+        // Der Webserver wird beendet: Stream sofort abschließen, solange die Anfrage noch gültig ist
+        if (xEventGroupGetBits(s_scan_events_group) & SCAN_EVENTS_STOP_BIT) {
+            break;
+        }
+        size_t num_entries = 0;
+        wifi_scan_info_t info = wifi_scanner_get_updates(&seq, s_event_entries, WIFI_SCAN_MAX_NETWORKS, &num_entries);
+        for (size_t i = 0; i < num_entries; i++) {
+            json_append(&writer, "event: ap\ndata: ");
+            json_append_entry(&writer, s_event_entries[i]);
+            json_append(&writer, "\n\n");
+        }
 
-    for (const auto& record : ap_records) {
-        cJSON *ap_item = cJSON_CreateObject();
-        cJSON_AddStringToObject(ap_item, "ssid", (const char *)record.ssid);
-        cJSON_AddNumberToObject(ap_item, "rssi", record.rssi);
-        cJSON_AddItemToArray(aps, ap_item);
+        bool timed_out = pdTICKS_TO_MS(xTaskGetTickCount() - start) >= SCAN_EVENTS_TIMEOUT_MS;
+        if (!info.scanning || timed_out) {
+            json_append(&writer, "event: done\ndata: {\"age\":%d}\n\n", scan_age_s(info));
+            json_flush(&writer);
+            break;
+        }
+        // Neue Netzwerke sofort senden, nicht erst, wenn der Puffer voll ist
+        json_flush(&writer);
+        wifi_scanner_wait_progress(SCAN_EVENTS_WAIT_MS);
     }
-    
-    char* json_str = cJSON_PrintUnformatted(root);
-    ESP_LOGI(TAG, "==> Sende JSON-Antwort an den Browser: %s", json_str);
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_str, strlen(json_str));
-    
-    // Speicher freigeben
-    free(json_str);
-    cJSON_Delete(root);
+    if (writer.err == ESP_OK) {
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    httpd_req_async_handler_complete(req);
+    s_scan_events_active = false;
+    xEventGroupSetBits(s_scan_events_group, SCAN_EVENTS_DONE_BIT);
+    vTaskDelete(NULL);
+}
 
+/**
+ * @brief Beendet einen laufenden SSE-Stream und wartet auf das Ende seines Tasks.
+ * Muss vor httpd_stop() aufgerufen werden, da der Task sonst auf eine freigegebene Anfrage zugreift.
+ */
+static void stop_scan_events() {
+    if (!s_scan_events_active) {
+        return;
+    }
+    xEventGroupSetBits(s_scan_events_group, SCAN_EVENTS_STOP_BIT);
+    EventBits_t bits = xEventGroupWaitBits(s_scan_events_group, SCAN_EVENTS_DONE_BIT, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(SCAN_EVENTS_STOP_TIMEOUT_MS));
+    if ((bits & SCAN_EVENTS_DONE_BIT) == 0) {
+        ESP_LOGE(TAG, "Scan event stream did not stop within %d ms", SCAN_EVENTS_STOP_TIMEOUT_MS);
+    }
+}
+
+/**
+ * @brief Startet einen SSE-Stream (`/scan/events`) mit den Scan-Ergebnissen.
+ *
+ * Die Anfrage wird an einen eigenen Task übergeben, damit der httpd-Task währenddessen weitere
+ * Anfragen bearbeiten kann. `?refresh=1` erzwingt wie bei /scan.json einen neuen Scan.
+ */
+esp_err_t WifiProvisioner::scan_events_handler_(httpd_req_t *req) {
+    if (s_scan_events_active) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    if (s_scan_events_group == nullptr) {
+        s_scan_events_group = xEventGroupCreate();
+        if (s_scan_events_group == nullptr) {
+            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start event stream");
+        }
+    }
+
+    char query[16];
+    bool refresh = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK && strstr(query, "refresh=1") != nullptr;
+    wifi_scanner_refresh(refresh ? 0 : WIFI_SCAN_MAX_AGE_MS);
+
+    httpd_req_t *async_req = nullptr;
+    if (httpd_req_async_handler_begin(req, &async_req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start event stream");
+    }
+    httpd_resp_set_type(async_req, "text/event-stream");
+    httpd_resp_set_hdr(async_req, "Cache-Control", "no-store");
+
+    xEventGroupClearBits(s_scan_events_group, SCAN_EVENTS_STOP_BIT | SCAN_EVENTS_DONE_BIT);
+    s_scan_events_active = true;
+    if (xTaskCreate(scan_events_task, "scan_events", SCAN_EVENTS_TASK_STACK_SIZE, async_req,
+                    SCAN_EVENTS_TASK_PRIORITY, NULL) != pdPASS) {
+        s_scan_events_active = false;
+        httpd_req_async_handler_complete(async_req);
+        return ESP_ERR_NO_MEM;
+    }
     return ESP_OK;
 }
+#endif // SCAN_EVENTS_AVAILABLE
 
 
 esp_err_t WifiProvisioner::save_post_handler_(httpd_req_t *req) {
-    // Puffer zum Lesen der POST-Daten erstellen
-    char buf[256];
-    int ret, remaining = req->content_len;
-    std::string content;
+    if (req->content_len > SAVE_MAX_BODY_LEN) {
+        ESP_LOGE(TAG, "Bad request: body of %u bytes is too large.", (unsigned)req->content_len);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "BAD REQUEST: Anfrage zu groß.");
+        return ESP_FAIL;
+    }
+
+    // Das Formular sendet urlencoded; Apps und Skripte können JSON schicken
+    char content_type[32] = {0};
+    httpd_req_get_hdr_value_str(req, "Content-Type", content_type, sizeof(content_type));
+    bool json = strncasecmp(content_type, "application/json", strlen("application/json")) == 0;
 
-    // Lese den gesamten Body der POST-Anfrage
+    // Jedes empfangene Stück wird sofort in die Felder dekodiert (kein Heap, keine Kopie des Bodys)
+    FormParser parser(json ? FORM_FORMAT_JSON : FORM_FORMAT_URLENCODED);
+    char buf[SAVE_RECV_CHUNK_SIZE];
+    int ret, remaining = req->content_len;
     while (remaining > 0) {
         ret = httpd_req_recv(req, buf, std::min(remaining, (int)sizeof(buf)));
         if (ret <= 0) {
@@ -398,108 +1881,283 @@ esp_err_t WifiProvisioner::save_post_handler_(httpd_req_t *req) {
             ESP_LOGE(TAG, "Failed to receive POST data");
             return ESP_FAIL;
         }
-        content.append(buf, ret);
+        // Nach einem Syntaxfehler muss der Rest nicht mehr gelesen werden
+        if (!parser.feed(buf, ret)) break;
         remaining -= ret;
     }
 
-    // Variablen für die extrahierten Werte
-    char ssid_encoded[128] = {0};
-    char ssid_decoded[128] = {0};
-    char password_encoded[64] = {0};
-    char password_decoded[64] = {0};
-    char timezone_encoded[128] = {0};
-    char timezone_decoded[128] = {0};
-
-    // Extrahiere die Key-Value-Paare aus dem POST-Body
-    if (httpd_query_key_value(content.c_str(), "ssid", ssid_encoded, sizeof(ssid_encoded)) != ESP_OK ||
-        httpd_query_key_value(content.c_str(), "timezone", timezone_encoded, sizeof(timezone_encoded)) != ESP_OK ||
-        strlen(ssid_encoded) == 0 || strlen(timezone_encoded) == 0) {
-        
-        ESP_LOGE(TAG, "Bad request: ssid or timezone parameter missing.");
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "BAD REQUEST: SSID und Zeitzone sind erforderlich.");
+    form_result_t result = parser.finish();
+    if (result != FORM_OK) {
+        ESP_LOGE(TAG, "Bad request (%s): %s %s", json ? "json" : "form", FormParser::result_name(result),
+                 parser.error_field());
+        const char *message = "BAD REQUEST: Ungültige Kodierung.";
+        if (result == FORM_ERR_MISSING) message = "BAD REQUEST: SSID und Zeitzone sind erforderlich.";
+        if (result == FORM_ERR_TOO_LONG) message = "BAD REQUEST: Wert zu lang.";
+        if (result == FORM_ERR_PASSWORD) message = "BAD REQUEST: Das Passwort muss 8-63 Zeichen oder 64 Hex-Ziffern lang sein.";
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, message);
         return ESP_FAIL;
     }
 
-    // Passwort ist optional
-    httpd_query_key_value(content.c_str(), "password", password_encoded, sizeof(password_encoded));
-
     // Hole den `this` Pointer auf die Klasseninstanz
     auto* provisioner = static_cast<WifiProvisioner*>(req->user_ctx);
 
-    url_decode(ssid_decoded,   ssid_encoded,   sizeof(ssid_decoded));
-    url_decode(password_decoded, password_encoded, sizeof(password_decoded));
-    url_decode(timezone_decoded, timezone_encoded, sizeof(timezone_decoded));
+    // Speichere die Daten in den Member-Variablen; deren Kapazität ist im Konstruktor reserviert,
+    // assign() allokiert daher nicht
+    provisioner->_ssid.assign(parser.ssid(), parser.ssid_len());
+    provisioner->_password.assign(parser.password(), parser.password_len());
+    provisioner->_timezone.assign(parser.timezone(), parser.timezone_len());
 
-    // Speichere die empfangenen und dekodierten Daten in den Member-Variablen der Klasse
-    provisioner->_ssid = ssid_decoded;
-    provisioner->_password = password_decoded;
-    provisioner->_timezone = timezone_decoded;
+    ESP_LOGI(TAG, "Credentials temporarily stored. Decoded timezone: %s", parser.timezone());
 
-    ESP_LOGI(TAG, "Credentials temporarily stored. Decoded timezone: %s", timezone_decoded);
+    // Die Zugangsdaten werden erst geprüft; gespeichert und beendet wird nach erfolgreicher Verbindung
+    // (siehe provisioning_task_). Das Ergebnis fragt die Seite über /status ab.
+    provisioner->start_validation_();
 
-    // Wenn das `persistent_storage`-Flag gesetzt wurde, speichere die Daten auch dauerhaft im NVS
-    if (provisioner->_persistent_storage) {
-        if (provisioner->save_credentials_to_nvs_() == ESP_OK) {
-            ESP_LOGI(TAG, "Credentials also saved persistently to NVS.");
-        } else {
-            ESP_LOGE(TAG, "Failed to save credentials to NVS!");
-        }
-    }
-    
+    httpd_resp_set_status(req, "202 Accepted");
     httpd_resp_send(req, "OK", HTTPD_RESP_USE_STRLEN);
 
-    // Signalisiere der wartenden start_provisioning-Funktion, dass die Eingabe erfolgreich war
-    xEventGroupSetBits(provisioner->_provisioning_event_group, PROV_SUCCESS_BIT);
-
     return ESP_OK;
 }
 
+void WifiProvisioner::start_validation_() {
+    // Scans und Verbindungsaufbau schließen sich gegenseitig aus
+    wifi_scanner_pause(true);
+    // Ein vorheriger Versuch wird abgebrochen; das folgende ASSOC_LEAVE wird ignoriert
+    esp_wifi_disconnect();
+
+    wifi_config_t wifi_config = {};
+    // Wie in build_sta_config(): volle Länge ohne Nullterminierung
+    memcpy(wifi_config.sta.ssid, _ssid.c_str(), std::min(_ssid.length(), sizeof(wifi_config.sta.ssid)));
+    memcpy(wifi_config.sta.password, _password.c_str(), std::min(_password.length(), sizeof(wifi_config.sta.password)));
+    wifi_config.sta.threshold.authmode = _password.length() > 0 ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+    wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+
+    _validation_attempts = 0;
+    _validation_reason = 0;
+    _validation_state = VALIDATION_CONNECTING;
+    // Die Zeitüberschreitung gilt auch, wenn die Seite /status nicht mehr abfragt (Telefon getrennt)
+    esp_timer_stop(_validation_timer);
+    esp_timer_start_once(_validation_timer, (uint64_t)VALIDATION_TIMEOUT_MS * 1000);
+
+    // Hinweis: Im APSTA-Modus wechselt der Access Point auf den Kanal des Routers. Das Telefon ist dabei
+    // ggf. kurz getrennt; die Seite fragt /status so lange weiter ab.
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    if (err == ESP_OK) err = esp_wifi_connect();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start credential check (%s)", esp_err_to_name(err));
+        finish_validation_(VALIDATION_FAILED, 0);
+        return;
+    }
+    ESP_LOGI(TAG, "Checking credentials for '%s'...", _ssid.c_str());
+}
+
+/**
+ * @brief Zeitüberschreitung der Verbindungsprüfung (läuft im esp_timer-Task): Die STA-Schnittstelle gibt
+ * den Kanal wieder frei, statt bis zum Ende des Portals weiter zu versuchen.
+ */
+void WifiProvisioner::validation_timer_cb_(void *arg) {
+    auto* provisioner = static_cast<WifiProvisioner*>(arg);
+    if (provisioner->_validation_state != VALIDATION_CONNECTING) {
+        return;
+    }
+    ESP_LOGW(TAG, "Credential check timed out after %d ms.", VALIDATION_TIMEOUT_MS);
+    esp_wifi_disconnect();
+    provisioner->finish_validation_(VALIDATION_FAILED, 0);
+}
+
+void WifiProvisioner::finish_validation_(validation_state_t state, uint8_t reason) {
+    esp_timer_stop(_validation_timer);
+    _validation_reason = reason;
+    _validation_state = state;
+    if (state == VALIDATION_CONNECTED) {
+        ESP_LOGI(TAG, "Credential check succeeded.");
+        // Signalisiere dem wartenden Provisionierungs-Task, dass die Eingabe erfolgreich war
+        xEventGroupSetBits(_provisioning_event_group, PROV_SUCCESS_BIT);
+    } else {
+        ESP_LOGW(TAG, "Credential check failed (reason %u).", reason);
+        wifi_scanner_pause(false);
+    }
+}
+
+void WifiProvisioner::on_validation_disconnect_(uint8_t reason) {
+    if (_validation_state != VALIDATION_CONNECTING || reason == WIFI_REASON_ASSOC_LEAVE) {
+        return;
+    }
+    // Ein falsches Passwort wird sofort gemeldet, andere Fehler erst nach mehreren Versuchen
+    if (!is_auth_failure(reason) && ++_validation_attempts < VALIDATION_MAX_ATTEMPTS) {
+        esp_wifi_connect();
+        return;
+    }
+    finish_validation_(VALIDATION_FAILED, reason);
+}
+
+/**
+ * @brief Liefert das Ergebnis der Verbindungsprüfung als JSON (`/status`).
+ *
+ * `{"state":"idle|connecting|connected|failed","reason":<Disconnect-Grund>,"error":"auth|noap|timeout|other","ip":"..."}`
+ */
+esp_err_t WifiProvisioner::status_get_handler_(httpd_req_t *req) {
+    auto* provisioner = static_cast<WifiProvisioner*>(req->user_ctx);
+
+    static const char *const state_names[] = { "idle", "connecting", "connected", "failed" };
+    validation_state_t state = provisioner->_validation_state;
+    uint8_t reason = provisioner->_validation_reason;
+    const char *error = "";
+    if (state == VALIDATION_FAILED) {
+        if (reason == 0) error = "timeout";
+        else if (is_auth_failure(reason)) error = "auth";
+        else if (reason == WIFI_REASON_NO_AP_FOUND) error = "noap";
+        else error = "other";
+    }
+
+    char json[128];
+    esp_ip4_addr_t ip = provisioner->_validation_ip;
+    snprintf(json, sizeof(json), "{\"state\":\"%s\",\"reason\":%u,\"error\":\"%s\",\"ip\":\"" IPSTR "\"}",
+             state_names[state], reason, error, IP2STR(&ip));
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
 void WifiProvisioner::wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
     // Hole die Instanz der Klasse aus dem Argument-Pointer
     WifiProvisioner* provisioner = static_cast<WifiProvisioner*>(arg);
     
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        // Im Portal verbindet sich die STA-Schnittstelle erst mit den eingegebenen Zugangsdaten
+        if (provisioner->_portal_active) return;
         ESP_LOGI(TAG, "EVENT: STA_START received. Initiating connection...");
-        esp_wifi_connect();
+        boot_timing_mark(BOOT_PHASE_STA_START);
+        if (s_select_on_start) {
+            s_select_on_start = false;
+            start_select_scan();
+        } else {
+            esp_wifi_connect();
+        }
     } 
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        // Scans des Portals (wifi_scan.cpp) werden dort ausgewertet
+        if (s_select_scan && !provisioner->_portal_active) {
+            provisioner->select_network_();
+        }
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        boot_timing_mark(BOOT_PHASE_ASSOCIATED);
+    }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
         ESP_LOGW(TAG, "EVENT: STA_DISCONNECTED. Reason code: %d.", event->reason);
 
-        if (s_retry_num < s_max_retries) {
-            // Warte eine Sekunde vor dem nächsten Versuch, um den Router nicht zu überlasten
-            vTaskDelay(pdMS_TO_TICKS(1000)); 
-
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "Retrying to connect... (Attempt %d/%d)", s_retry_num, s_max_retries);
-        } else {
-            ESP_LOGE(TAG, "Failed to connect after %d attempts. Erasing credentials and rebooting into provisioning mode.", s_max_retries);
-            
-            // Lösche die gespeicherten Zugangsdaten
-            nvs_handle_t nvs_handle;
-            nvs_open(PROV_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-            nvs_erase_key(nvs_handle, "ssid");
-            nvs_erase_key(nvs_handle, "password");
-            nvs_erase_key(nvs_handle, "timezone");
-            nvs_commit(nvs_handle);
-            nvs_close(nvs_handle);
-            
-            // Starte das Gerät neu
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            esp_restart();
+        if (provisioner->_portal_active) {
+            // Verbindungsprüfung im Portal: kein Backoff, keine Löschung, das Ergebnis geht an /status
+            provisioner->on_validation_disconnect_(event->reason);
+        }
+        else if (s_directed_connect) {
+            // Der gespeicherte Access Point ist nicht (mehr) erreichbar: sofort mit einem vollständigen
+            // Scan neu versuchen, ohne dies als Fehlversuch für den Backoff zu zählen. Der Hinweis bleibt
+            // erhalten: Er zeigt beim nächsten Start, dass diese Zugangsdaten schon funktioniert haben (z.B.
+            // wenn das Gerät nach einem Stromausfall vor dem Router startet), und die nächste erfolgreiche
+            // Verbindung ersetzt ihn ohnehin (save_sta_hint()).
+            s_directed_connect = false;
+            if (provisioner->roaming_enabled_()) {
+                // Mehrere Netzwerke: das Gerät steht evtl. an einem anderen Ort, also unter allen auswählen
+                ESP_LOGW(TAG, "Fast connect failed. Scanning for the best known network.");
+                record_attempt(provisioner->_ssid, false, 0);
+                start_select_scan();
+            } else {
+                ESP_LOGW(TAG, "Fast connect failed. Falling back to a full scan.");
+                // Ein anderer Access Point verlangt evtl. WPA3, daher wieder das Passwort statt des PMK
+                wifi_config_t wifi_config;
+                build_sta_config(&wifi_config, provisioner->_ssid, provisioner->_password, nullptr);
+                esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+                s_connect_start = xTaskGetTickCount();
+                esp_wifi_connect();
+            }
+        }
+        else if (event->reason == WIFI_REASON_ASSOC_LEAVE) {
+            // Eigene Trennung (esp_wifi_disconnect/esp_wifi_stop, z.B. beim Beenden des Portals)
+            ESP_LOGI(TAG, "Disconnected on request, not reconnecting.");
+        }
+        else if (s_selecting && s_candidate_pos + 1 < s_num_candidates) {
+            // Nächstes Netzwerk der Auswahl sofort versuchen
+            record_attempt(provisioner->_ssid, false, 0);
+            s_candidate_pos++;
+            provisioner->connect_candidate_();
+        }
+        else {
+            // Kein Warten im Event-Handler: der nächste Versuch wird über einen Timer geplant
+            if (is_auth_failure(event->reason)) s_auth_failures++;
+            if (is_unreachable_failure(event->reason)) s_unreachable_failures++;
+
+            // Mit mehreren Netzwerken wird nach der Wartezeit neu gescannt und ausgewählt, und falsche
+            // Zugangsdaten eines Netzwerks führen nicht zurück ins Portal
+            bool roaming = provisioner->roaming_enabled_();
+            if (roaming) {
+                record_attempt(provisioner->_ssid, false, 0);
+            }
+            s_selecting = false;
+
+            if (!roaming && !provisioner->_has_been_connected && s_auth_failures >= RECONNECT_MAX_AUTH_FAILURES) {
+                ESP_LOGE(TAG, "Authentication failed %u times. Erasing credentials and rebooting into provisioning mode.",
+                         (unsigned)s_auth_failures);
+                schedule_reconnect(RECONNECT_ACTION_RESET, RECONNECT_RESET_DELAY_MS);
+            } else if (!roaming && !provisioner->_has_been_connected && !s_connected_before &&
+                       s_unreachable_failures >= RECONNECT_MAX_UNREACHABLE_FAILURES) {
+                ESP_LOGE(TAG, "Network not usable after %u attempts (reason %d) and never connected. "
+                         "Erasing credentials and rebooting into provisioning mode.",
+                         (unsigned)s_unreachable_failures, event->reason);
+                schedule_reconnect(RECONNECT_ACTION_RESET, RECONNECT_RESET_DELAY_MS);
+            } else {
+                uint32_t delay_ms = reconnect_delay_ms(s_reconnect_attempt++);
+                ESP_LOGI(TAG, "Retrying to connect in %u ms (attempt %u, %s)", (unsigned)delay_ms,
+                         (unsigned)s_reconnect_attempt, is_auth_failure(event->reason) ? "auth failure" : "AP unreachable");
+                schedule_reconnect(roaming ? RECONNECT_ACTION_SELECT : RECONNECT_ACTION_CONNECT, delay_ms);
+            }
         }
     } 
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "EVENT: GOT_IP. Successfully connected! IP: " IPSTR, IP2STR(&event->ip_info.ip));
+
+        if (provisioner->_portal_active) {
+            // Verbindungsprüfung im Portal erfolgreich; die eigentliche Verbindung folgt mit connect_sta()
+            if (provisioner->_validation_state == VALIDATION_CONNECTING) {
+                provisioner->_validation_ip = event->ip_info.ip;
+                provisioner->finish_validation_(VALIDATION_CONNECTED, 0);
+            }
+            return;
+        }
         
+        if (!provisioner->_has_been_connected) {
+            ESP_LOGI(TAG, "Connected %u ms after start (%s).", (unsigned)pdTICKS_TO_MS(xTaskGetTickCount() - s_connect_start),
+                     s_directed_connect ? "fast connect" : s_selecting ? "selected after scan" : "full scan");
+            boot_timing_mark(BOOT_PHASE_GOT_IP);
+            // Geschrieben wird einmal, wenn auch die Zeitsynchronisierung bekannt ist
+            boot_timing_schedule_save(BOOT_TIMING_SAVE_TIMEOUT_MS);
+        }
+        s_directed_connect = false;
+        s_selecting = false;
+
+        // Verlauf des Netzwerks für die Auswahl unter mehreren Netzwerken fortschreiben
+        if (provisioner->roaming_enabled_()) {
+            record_attempt(provisioner->_ssid, true, pdTICKS_TO_MS(xTaskGetTickCount() - s_connect_start));
+        }
+
+        // BSSID und Kanal für den nächsten Start merken, sofern die Zugangsdaten dauerhaft gespeichert sind
+        if (provisioner->is_provisioned()) {
+            save_sta_hint(provisioner->_ssid);
+        }
+
         // Flag, dass es eine erfolgreiche Verbindung gab
         provisioner->_has_been_connected = true;
 
-        // Setze den Zähler bei Erfolg zurück und erhöhe das Retry Limit
-        s_retry_num = 0; 
-        s_max_retries = WIFI_MAX_RETRIES_RECONNECT;
+        // Backoff und Fehlerzähler bei Erfolg zurücksetzen
+        esp_timer_stop(s_reconnect_timer);
+        s_reconnect_attempt = 0;
+        s_auth_failures = 0;
+        s_unreachable_failures = 0;
+        s_connected_before = true;
 
         // Starte die Zeitsynchronisierung
         provisioner->synchronize_time();
@@ -510,6 +2168,10 @@ void WifiProvisioner::time_sync_notification_cb(struct timeval *tv) {
     ESP_LOGI(TAG, "Zeitsynchronisierung erfolgreich abgeschlossen.");
     // Greife über den statischen Pointer auf die Instanz zu und setze das Flag
     if (s_instance) {
+        if (!s_instance->_is_time_synced) {
+            // Letzte Phase: weckt den Task aus boot_timing_schedule_save(), der den Start speichert
+            boot_timing_mark(BOOT_PHASE_SNTP_SYNC);
+        }
         s_instance->_is_time_synced = true;
     }
 }
@@ -531,4 +2193,16 @@ void WifiProvisioner::synchronize_time() {
 
 bool WifiProvisioner::is_time_synchronized() const {
     return _is_time_synced;
+}
+
+const boot_timing_t& WifiProvisioner::get_boot_timing() const {
+    return boot_timing_current();
+}
+
+esp_err_t WifiProvisioner::get_boot_timing_summary(boot_timing_summary_t& summary) const {
+    return boot_timing_get_summary(&summary);
+}
+
+void WifiProvisioner::log_boot_timing() const {
+    boot_timing_log_summary();
 }
\ No newline at end of file
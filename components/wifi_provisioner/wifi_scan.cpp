@@ -0,0 +1,477 @@
+#include "esp_log.h"
+#include "esp_idf_version.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+#include "wifi_scan.hpp"
+
+#define SCAN_TASK_STACK_SIZE 4096
+#define SCAN_TASK_PRIORITY 4
+
+// Ein vollständiger Durchlauf über alle Kanäle dauert je nach Land 2-4 Sekunden
+#define SCAN_STOP_TIMEOUT_MS 5000
+
+// Aktive Scan-Dauer pro Kanal. Zwischen den Kanälen kehrt das Funkmodul auf den Kanal des eigenen
+// Access Points zurück, sodass das verbundene Telefon nicht die ganze Scan-Dauer ohne Verbindung ist.
+#define SCAN_ACTIVE_MIN_MS 40
+#define SCAN_ACTIVE_MAX_MS 120
+
+// Die in fast allen Ländern überlappungsfreien Kanäle zuerst; hier finden sich die meisten Netzwerke
+static const uint8_t s_priority_channels[] = { 1, 6, 11 };
+
+// Bewertung der Kanäle beim Vorab-Scan: Jeder Access Point zählt CHANNEL_AP_WEIGHT plus seine
+// Signalstärke über CHANNEL_RSSI_FLOOR (ein Nachbar-Router mit -40 dBm stört mehr als einer mit -90 dBm)
+#define CHANNEL_AP_WEIGHT 20
+#define CHANNEL_RSSI_FLOOR -100
+// 20-MHz-Kanäle im 2,4-GHz-Band liegen 5 MHz auseinander und überlappen bis zu 4 Kanäle weit;
+// ein Access Point belastet Nachbarkanäle anteilig (Abstand 1 = 4/5, ..., Abstand 4 = 1/5)
+#define CHANNEL_OVERLAP 5
+#define CHANNEL_MAX 14
+// Für den eigenen Access Point kommen nur die Kanäle 1-11 in Frage: 12 und 13 sind nicht in allen Ländern
+// erlaubt, und am Rand des Bandes fehlt die Hälfte der Nachbarn, sodass sie sonst fast immer gewönnen.
+// Ein Kanal außerhalb von 1, 6 und 11 überlappt mit zwei davon und muss um etwa einen Nachbar-Router mit
+// -60 dBm besser sein, um gewählt zu werden.
+#define CHANNEL_AP_MAX 11
+#define CHANNEL_OFF_GRID_PENALTY (CHANNEL_AP_WEIGHT + 40)
+
+// Bits für die Event Group
+#define SCAN_REQUEST_BIT  BIT0
+#define SCAN_STOP_BIT     BIT1
+#define SCAN_STOPPED_BIT  BIT2
+#define SCAN_PROGRESS_BIT BIT3
+
+// Statische Variablen für den Task
+static const char *TAG = "WIFI_SCAN";
+static TaskHandle_t s_scan_task = nullptr;
+static EventGroupHandle_t s_scan_events = nullptr;
+static SemaphoreHandle_t s_cache_mutex = nullptr;
+
+// Alle folgenden Variablen sind durch s_cache_mutex geschützt.
+// Ergebnis des laufenden Durchlaufs, wächst Kanal für Kanal
+static wifi_scan_entry_t s_live[WIFI_SCAN_MAX_NETWORKS];
+static size_t s_num_live = 0;
+// Ergebnis des letzten vollständigen Durchlaufs
+static wifi_scan_entry_t s_cache[WIFI_SCAN_MAX_NETWORKS];
+static size_t s_num_cached = 0;
+static TickType_t s_cache_time = 0;
+static bool s_cache_valid = false;
+static bool s_scanning = false;
+// Während einer Verbindungsprüfung ruht der Scanner (siehe wifi_scanner_pause())
+static bool s_paused = false;
+// Fortlaufende Nummer der letzten Änderung an einem Eintrag
+static uint32_t s_seq = 0;
+
+/**
+ * @brief Übernimmt einen Access Point in s_live, zusammengefasst nach SSID.
+ *
+ * Pro SSID bleibt der Access Point mit dem stärksten Signal. Ist die Liste voll, verdrängt ein
+ * stärkeres Netzwerk das schwächste. Versteckte Netzwerke (leere SSID) werden nicht aufgenommen.
+ * Jeder neue oder geänderte Eintrag erhält eine neue Sequenznummer.
+ */
+static void merge_record(const wifi_ap_record_t& record) {
+    const char *ssid = (const char *)record.ssid;
+    if (ssid[0] == '\0') {
+        return;
+    }
+
+    wifi_scan_entry_t *slot = nullptr;
+    wifi_scan_entry_t *weakest = nullptr;
+    for (size_t i = 0; i < s_num_live; i++) {
+        if (strncmp(s_live[i].ssid, ssid, sizeof(s_live[i].ssid)) == 0) {
+            if (record.rssi <= s_live[i].rssi) return;
+            slot = &s_live[i];
+            break;
+        }
+        if (weakest == nullptr || s_live[i].rssi < weakest->rssi) weakest = &s_live[i];
+    }
+
+    if (slot == nullptr) {
+        if (s_num_live < WIFI_SCAN_MAX_NETWORKS) {
+            slot = &s_live[s_num_live++];
+        } else if (weakest != nullptr && record.rssi > weakest->rssi) {
+            slot = weakest;
+        } else {
+            return;
+        }
+        strncpy(slot->ssid, ssid, sizeof(slot->ssid) - 1);
+        slot->ssid[sizeof(slot->ssid) - 1] = '\0';
+    }
+    slot->rssi = record.rssi;
+    slot->channel = record.primary;
+    slot->authmode = record.authmode;
+    slot->seq = ++s_seq;
+}
+
+/**
+ * @brief Addiert die Last eines Access Points auf seinem Primärkanal (siehe CHANNEL_AP_WEIGHT).
+ * Anders als s_live zählt hier jeder Access Point, auch versteckte und mehrere BSSIDs einer SSID.
+ */
+static void add_channel_load(uint32_t *load, const wifi_ap_record_t& record) {
+    if (load == nullptr || record.primary == 0 || record.primary > CHANNEL_MAX) {
+        return;
+    }
+    load[record.primary] += CHANNEL_AP_WEIGHT + std::max(0, record.rssi - CHANNEL_RSSI_FLOOR);
+}
+
+/**
+ * @brief Scannt einen einzelnen Kanal (blockierend, nur der aufrufende Task wartet) und übernimmt die
+ * Ergebnisse in s_live.
+ * @param load Optional: Last pro Kanal (Index = Kanal), wird um die gefundenen Access Points erhöht.
+ * @return Anzahl der vom Treiber gemeldeten Access Points auf diesem Kanal.
+ */
+static uint16_t scan_channel(uint8_t channel, uint32_t *load = nullptr) {
+    wifi_scan_config_t config = {};
+    config.channel = channel;
+    config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+    config.scan_time.active.min = SCAN_ACTIVE_MIN_MS;
+    config.scan_time.active.max = SCAN_ACTIVE_MAX_MS;
+
+    if (esp_wifi_scan_start(&config, true) != ESP_OK) {
+        return 0;
+    }
+    uint16_t num_aps = 0;
+    esp_wifi_scan_get_ap_num(&num_aps);
+
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+    // Einzeln aus der Liste des Treibers lesen, ohne Zwischenpuffer für alle Access Points
+    wifi_ap_record_t record;
+    while (esp_wifi_scan_get_ap_record(&record) == ESP_OK) {
+        merge_record(record);
+        add_channel_load(load, record);
+    }
+#else
+    // Ältere IDF-Versionen: in festen Blöcken lesen; der Treiber gibt seine Liste danach frei
+    static wifi_ap_record_t records[WIFI_SCAN_MAX_NETWORKS];
+    uint16_t count = std::min<uint16_t>(num_aps, WIFI_SCAN_MAX_NETWORKS);
+    esp_wifi_scan_get_ap_records(&count, records);
+    for (uint16_t i = 0; i < count; i++) {
+        merge_record(records[i]);
+        add_channel_load(load, records[i]);
+    }
+#endif
+    // Sortierung nach RSSI (absteigend, da höhere Werte besser sind)
+    std::sort(s_live, s_live + s_num_live, [](const wifi_scan_entry_t& a, const wifi_scan_entry_t& b) {
+        return a.rssi > b.rssi;
+    });
+    xSemaphoreGive(s_cache_mutex);
+    return num_aps;
+}
+
+/**
+ * @brief Legt die Reihenfolge der Kanäle fest: 1, 6, 11, danach alle übrigen im erlaubten Bereich.
+ * @return Anzahl der Kanäle in `order`.
+ */
+static size_t channel_order(uint8_t *order, size_t max_channels) {
+    wifi_country_t country = {};
+    uint8_t first = 1;
+    uint8_t count = 13;
+    if (esp_wifi_get_country(&country) == ESP_OK && country.nchan > 0) {
+        first = country.schan;
+        count = country.nchan;
+    }
+
+    size_t n = 0;
+    for (uint8_t channel : s_priority_channels) {
+        if (channel >= first && channel < first + count && n < max_channels) order[n++] = channel;
+    }
+    for (uint8_t channel = first; channel < first + count && n < max_channels; channel++) {
+        if (std::find(std::begin(s_priority_channels), std::end(s_priority_channels), channel) == std::end(s_priority_channels)) {
+            order[n++] = channel;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Übernimmt den abgeschlossenen Durchlauf als Cache; erfordert s_cache_mutex.
+ */
+static void promote_live() {
+    memcpy(s_cache, s_live, s_num_live * sizeof(s_live[0]));
+    s_num_cached = s_num_live;
+    s_cache_time = xTaskGetTickCount();
+    s_cache_valid = true;
+}
+
+/**
+ * @brief Alter des Caches; erfordert s_cache_mutex.
+ */
+static uint32_t cache_age_ms() {
+    return s_cache_valid ? pdTICKS_TO_MS(xTaskGetTickCount() - s_cache_time) : WIFI_SCAN_AGE_NONE;
+}
+
+/**
+ * @brief Der FreeRTOS-Task, der auf Scan-Anfragen wartet.
+ *
+ * Jeder Durchlauf scannt Kanal für Kanal und meldet nach jedem Kanal den Fortschritt
+ * (SCAN_PROGRESS_BIT), damit die Seite neue Netzwerke sofort anzeigen kann.
+ */
+static void wifi_scan_task(void *pvParameters) {
+    uint8_t channels[14];
+
+    while (true) {
+        EventBits_t bits = xEventGroupWaitBits(s_scan_events, SCAN_REQUEST_BIT | SCAN_STOP_BIT,
+                                               pdTRUE, pdFALSE, portMAX_DELAY);
+        if (bits & SCAN_STOP_BIT) {
+            break;
+        }
+
+        TickType_t start = xTaskGetTickCount();
+        xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+        s_num_live = 0;
+        xSemaphoreGive(s_cache_mutex);
+
+        size_t num_channels = channel_order(channels, sizeof(channels));
+        unsigned num_aps = 0;
+        bool aborted = false;
+        for (size_t i = 0; i < num_channels && !aborted; i++) {
+            num_aps += scan_channel(channels[i]);
+            xEventGroupSetBits(s_scan_events, SCAN_PROGRESS_BIT);
+            xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+            aborted = s_paused || (xEventGroupGetBits(s_scan_events) & SCAN_STOP_BIT);
+            xSemaphoreGive(s_cache_mutex);
+        }
+
+        xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+        // Ein abgebrochener Durchlauf ist unvollständig; der bisherige Cache bleibt dann gültig
+        if (!aborted) {
+            promote_live();
+        }
+        s_scanning = false;
+        xSemaphoreGive(s_cache_mutex);
+        xEventGroupSetBits(s_scan_events, SCAN_PROGRESS_BIT);
+
+        ESP_LOGI(TAG, "Scan of %u channels %s after %u ms, %u access points, %u networks",
+                 (unsigned)num_channels, aborted ? "aborted" : "finished",
+                 (unsigned)pdTICKS_TO_MS(xTaskGetTickCount() - start), num_aps, (unsigned)s_num_live);
+    }
+
+    ESP_LOGI(TAG, "WiFi scanner stopped");
+    s_scan_task = nullptr;
+    xEventGroupSetBits(s_scan_events, SCAN_STOPPED_BIT);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Legt Event Group und Mutex beim ersten Aufruf an.
+ */
+static esp_err_t init_sync() {
+    if (s_scan_events == nullptr) {
+        s_scan_events = xEventGroupCreate();
+        s_cache_mutex = xSemaphoreCreateMutex();
+    }
+    return (s_scan_events == nullptr || s_cache_mutex == nullptr) ? ESP_ERR_NO_MEM : ESP_OK;
+}
+
+esp_err_t wifi_scanner_prescan(uint8_t *best_channel) {
+    *best_channel = 0;
+    if (s_scan_task != nullptr) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = init_sync();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    s_num_live = 0;
+    xSemaphoreGive(s_cache_mutex);
+
+    uint8_t channels[CHANNEL_MAX];
+    uint32_t load[CHANNEL_MAX + 1] = {};
+    size_t num_channels = channel_order(channels, sizeof(channels));
+    unsigned num_aps = 0;
+    for (size_t i = 0; i < num_channels; i++) {
+        num_aps += scan_channel(channels[i], load);
+    }
+
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    promote_live();
+    xSemaphoreGive(s_cache_mutex);
+
+    // Der Kanal mit der geringsten Last inklusive der überlappenden Nachbarn gewinnt; bei Gleichstand
+    // der erste in channel_order(), also 1, 6 oder 11. Gescannt werden alle Kanäle, damit Router auf 12
+    // und 13 als Nachbarn von 11 zählen.
+    uint32_t best_score = UINT32_MAX;
+    for (size_t i = 0; i < num_channels; i++) {
+        int channel = channels[i];
+        if (channel > CHANNEL_AP_MAX) {
+            continue;
+        }
+        bool on_grid = std::find(std::begin(s_priority_channels), std::end(s_priority_channels), channel) !=
+                       std::end(s_priority_channels);
+        uint32_t score = on_grid ? 0 : CHANNEL_OFF_GRID_PENALTY;
+        for (int other = 1; other <= CHANNEL_MAX; other++) {
+            int distance = std::abs(other - channel);
+            if (distance < CHANNEL_OVERLAP) {
+                score += load[other] * (CHANNEL_OVERLAP - distance) / CHANNEL_OVERLAP;
+            }
+        }
+        ESP_LOGD(TAG, "Channel %d: load %u, score %u", channel, (unsigned)load[channel], (unsigned)score);
+        if (score < best_score) {
+            best_score = score;
+            *best_channel = channel;
+        }
+    }
+
+    ESP_LOGI(TAG, "Prescan of %u channels finished after %u ms, %u access points, %u networks; "
+             "least congested channel %u (score %u)",
+             (unsigned)num_channels, (unsigned)pdTICKS_TO_MS(xTaskGetTickCount() - start), num_aps,
+             (unsigned)s_num_cached, *best_channel, (unsigned)best_score);
+    return *best_channel != 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t start_wifi_scanner() {
+    if (s_scan_task != nullptr) {
+        return ESP_OK;
+    }
+    esp_err_t err = init_sync();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    xEventGroupClearBits(s_scan_events, SCAN_REQUEST_BIT | SCAN_STOP_BIT | SCAN_STOPPED_BIT | SCAN_PROGRESS_BIT);
+    s_scanning = false;
+    s_paused = false;
+    if (xTaskCreate(wifi_scan_task, "wifi_scan", SCAN_TASK_STACK_SIZE, NULL, SCAN_TASK_PRIORITY, &s_scan_task) != pdPASS) {
+        s_scan_task = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Den ersten Scan sofort starten, damit beim Öffnen der Seite schon Ergebnisse vorliegen; nach
+    // einem Vorab-Scan (wifi_scanner_prescan()) ist das erst nötig, wenn dessen Ergebnisse veralten
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    bool fresh = cache_age_ms() < WIFI_SCAN_MAX_AGE_MS;
+    xSemaphoreGive(s_cache_mutex);
+    if (!fresh) {
+        wifi_scanner_request_scan();
+    }
+    return ESP_OK;
+}
+
+void stop_wifi_scanner() {
+    if (s_scan_task == nullptr) {
+        return;
+    }
+    // Ein laufender Scan wird abgebrochen, damit der Task nicht bis zum Ende des Durchlaufs blockiert
+    xEventGroupSetBits(s_scan_events, SCAN_STOP_BIT);
+    esp_wifi_scan_stop();
+    xEventGroupWaitBits(s_scan_events, SCAN_STOPPED_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(SCAN_STOP_TIMEOUT_MS));
+
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    s_num_live = 0;
+    s_num_cached = 0;
+    s_cache_valid = false;
+    xSemaphoreGive(s_cache_mutex);
+}
+
+bool wifi_scanner_request_scan() {
+    if (s_scan_task == nullptr) {
+        return false;
+    }
+
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    bool start = !s_scanning && !s_paused;
+    if (start) s_scanning = true;
+    xSemaphoreGive(s_cache_mutex);
+
+    if (start) {
+        xEventGroupSetBits(s_scan_events, SCAN_REQUEST_BIT);
+    }
+    return start;
+}
+
+void wifi_scanner_pause(bool paused) {
+    if (s_cache_mutex == nullptr) {
+        return;
+    }
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    s_paused = paused;
+    bool scanning = s_scanning;
+    xSemaphoreGive(s_cache_mutex);
+
+    // Den gerade laufenden Kanal abbrechen; der Task beendet den Durchlauf danach
+    if (paused && scanning) {
+        esp_wifi_scan_stop();
+    }
+}
+
+wifi_scan_info_t wifi_scanner_get_results(wifi_scan_entry_t *entries, size_t max_entries, size_t *num_entries,
+                                          uint32_t max_age_ms) {
+    wifi_scan_info_t info = { WIFI_SCAN_AGE_NONE, false };
+    *num_entries = 0;
+    if (s_cache_mutex == nullptr) {
+        return info;
+    }
+
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    // Vor dem ersten vollständigen Durchlauf die bisher gefundenen Netzwerke liefern
+    const wifi_scan_entry_t *source = s_cache_valid ? s_cache : s_live;
+    *num_entries = std::min(max_entries, s_cache_valid ? s_num_cached : s_num_live);
+    memcpy(entries, source, *num_entries * sizeof(source[0]));
+    info.age_ms = cache_age_ms();
+    xSemaphoreGive(s_cache_mutex);
+
+    // Nach einer Anfrage (eigene oder zusammengelegte) den aktuellen Zustand melden
+    info.scanning = wifi_scanner_refresh(max_age_ms);
+    return info;
+}
+
+bool wifi_scanner_refresh(uint32_t max_age_ms) {
+    if (s_cache_mutex == nullptr) {
+        return false;
+    }
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    uint32_t age_ms = cache_age_ms();
+    xSemaphoreGive(s_cache_mutex);
+
+    if (age_ms == WIFI_SCAN_AGE_NONE || age_ms >= max_age_ms) {
+        wifi_scanner_request_scan();
+    }
+
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    bool scanning = s_scanning;
+    xSemaphoreGive(s_cache_mutex);
+    return scanning;
+}
+
+wifi_scan_info_t wifi_scanner_get_updates(uint32_t *seq, wifi_scan_entry_t *entries, size_t max_entries,
+                                          size_t *num_entries) {
+    wifi_scan_info_t info = { WIFI_SCAN_AGE_NONE, false };
+    *num_entries = 0;
+    if (s_cache_mutex == nullptr) {
+        return info;
+    }
+
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    // Während eines Durchlaufs dessen Zwischenstand, sonst das letzte vollständige Ergebnis
+    const wifi_scan_entry_t *source = s_scanning ? s_live : s_cache;
+    size_t count = s_scanning ? s_num_live : s_num_cached;
+    uint32_t newest = *seq;
+    for (size_t i = 0; i < count && *num_entries < max_entries; i++) {
+        if (source[i].seq > *seq) {
+            entries[(*num_entries)++] = source[i];
+            newest = std::max(newest, source[i].seq);
+        }
+    }
+    *seq = newest;
+    info.age_ms = cache_age_ms();
+    info.scanning = s_scanning;
+    xSemaphoreGive(s_cache_mutex);
+    return info;
+}
+
+bool wifi_scanner_wait_progress(uint32_t timeout_ms) {
+    if (s_scan_events == nullptr) {
+        return false;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_scan_events, SCAN_PROGRESS_BIT, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+    return (bits & SCAN_PROGRESS_BIT) != 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file wifi_scan.hpp
+ * @brief WLAN-Scan im Hintergrund mit zwischengespeicherten Ergebnissen.
+ *
+ * Ein eigener FreeRTOS-Task führt die Scans aus, sodass der Webserver währenddessen weiter Anfragen
+ * beantworten kann. Abfragen erhalten sofort die zuletzt gefundenen Netzwerke samt Alter; sind diese
+ * veraltet, wird im Hintergrund ein neuer Scan angestoßen. Anfragen, die während eines laufenden Scans
+ * eintreffen, lösen keinen weiteren Scan aus.
+ *
+ * Ein Durchlauf scannt Kanal für Kanal (1, 6 und 11 zuerst). Nach jedem Kanal stehen die bisher
+ * gefundenen Netzwerke bereit, sodass die Seite die ersten Einträge nach wenigen hundert Millisekunden
+ * anzeigen kann (siehe wifi_scanner_get_updates()).
+ *
+ * Die Ergebnisse werden nach SSID zusammengefasst: Mesh-Systeme und Repeater senden dieselbe SSID von
+ * mehreren BSSIDs, angezeigt wird nur der stärkste Eintrag. Der Cache ist ein festes Array, ein Scan
+ * belegt also unabhängig von der Anzahl sichtbarer Access Points keinen zusätzlichen Heap.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+#include "esp_wifi.h"
+
+// Ergebnisse, die älter sind, lösen beim Abruf einen neuen Scan aus
+#define WIFI_SCAN_MAX_AGE_MS 15000
+
+// Alter, solange noch kein Scan abgeschlossen wurde
+#define WIFI_SCAN_AGE_NONE UINT32_MAX
+
+// Maximale Anzahl unterschiedlicher SSIDs im Cache; bei mehr bleiben die stärksten erhalten
+#define WIFI_SCAN_MAX_NETWORKS 32
+
+struct wifi_scan_entry_t {
+    char ssid[33];               // Nullterminiert
+    int8_t rssi;                 // Stärkster empfangener Access Point dieser SSID
+    uint8_t channel;             // Primärkanal dieses Access Points
+    wifi_auth_mode_t authmode;
+    uint32_t seq;                // Fortlaufende Nummer der letzten Änderung (siehe wifi_scanner_get_updates)
+};
+
+struct wifi_scan_info_t {
+    uint32_t age_ms;  // Alter der Ergebnisse in Millisekunden oder WIFI_SCAN_AGE_NONE
+    bool scanning;    // Ein Scan läuft gerade (die Ergebnisse werden bald aktualisiert)
+};
+
+/**
+ * @brief Scannt einmal alle Kanäle (blockierend) und bestimmt den am wenigsten belegten Kanal.
+ *
+ * Gedacht für den Start des Portals, bevor der eigene Access Point sendet: Jeder gefundene Access Point
+ * belastet seinen Kanal abhängig von seiner Signalstärke und die überlappenden Nachbarkanäle anteilig.
+ * Das Ergebnis füllt zugleich den Cache, sodass der erste Abruf der Netzwerkliste keinen weiteren
+ * Scan braucht.
+ *
+ * @param best_channel Der Kanal mit der geringsten Last (bei Gleichstand 1, 6 oder 11); 0 bei Fehler.
+ * @return ESP_ERR_INVALID_STATE, wenn der Scan-Task bereits läuft.
+ * @note Der WLAN-Treiber muss im STA-Modus laufen.
+ */
+esp_err_t wifi_scanner_prescan(uint8_t *best_channel);
+
+/**
+ * @brief Startet den Scan-Task und sofort einen ersten Scan (entfällt nach einem aktuellen Vorab-Scan).
+ * @note Der WLAN-Treiber muss im STA- oder APSTA-Modus laufen.
+ */
+esp_err_t start_wifi_scanner();
+
+/**
+ * @brief Bricht einen laufenden Scan ab und beendet den Scan-Task.
+ */
+void stop_wifi_scanner();
+
+/**
+ * @brief Stößt einen neuen Scan an, sofern nicht bereits einer läuft.
+ * @return true, wenn ein neuer Scan gestartet wurde; false, wenn die Anfrage mit dem laufenden
+ * Scan zusammengelegt wurde oder der Scan-Task nicht läuft.
+ */
+bool wifi_scanner_request_scan();
+
+/**
+ * @brief Hält den Scanner an oder gibt ihn wieder frei.
+ *
+ * Ein laufender Durchlauf wird abgebrochen (die bisherigen Ergebnisse bleiben erhalten), neue Anfragen
+ * werden bis zur Freigabe ignoriert. Nötig, während die STA-Schnittstelle eine Verbindung aufbaut.
+ */
+void wifi_scanner_pause(bool paused);
+
+/**
+ * @brief Kopiert die zuletzt gefundenen Netzwerke (nach RSSI absteigend sortiert).
+ *
+ * @param entries Zielpuffer für höchstens `max_entries` Einträge.
+ * @param max_entries Größe des Zielpuffers (WIFI_SCAN_MAX_NETWORKS für alle Einträge).
+ * @param num_entries Anzahl der kopierten Einträge.
+ * @param max_age_ms Sind die Ergebnisse älter, wird ein neuer Scan angestoßen (0 = immer).
+ * @return Alter der Ergebnisse und ob gerade ein Scan läuft.
+ */
+wifi_scan_info_t wifi_scanner_get_results(wifi_scan_entry_t *entries, size_t max_entries, size_t *num_entries,
+                                          uint32_t max_age_ms = WIFI_SCAN_MAX_AGE_MS);
+
+/**
+ * @brief Stößt einen neuen Scan an, wenn die Ergebnisse älter als `max_age_ms` sind.
+ * @return true, wenn (jetzt) ein Scan läuft.
+ */
+bool wifi_scanner_refresh(uint32_t max_age_ms = WIFI_SCAN_MAX_AGE_MS);
+
+/**
+ * @brief Liefert alle Netzwerke, die seit der Sequenznummer `*seq` neu gefunden oder verändert wurden.
+ *
+ * Während eines Durchlaufs stammen die Einträge aus dessen Zwischenstand, sonst aus dem letzten
+ * vollständigen Ergebnis. Beginnend mit `*seq = 0` erhält der Aufrufer so zuerst alle bekannten und
+ * danach nur noch neue Netzwerke.
+ *
+ * @param seq Ein- und Ausgabe: höchste bereits gelieferte Sequenznummer.
+ * @param entries Zielpuffer für höchstens `max_entries` Einträge.
+ * @param max_entries Größe des Zielpuffers.
+ * @param num_entries Anzahl der kopierten Einträge.
+ * @return Alter der Ergebnisse und ob gerade ein Scan läuft.
+ */
+wifi_scan_info_t wifi_scanner_get_updates(uint32_t *seq, wifi_scan_entry_t *entries, size_t max_entries,
+                                          size_t *num_entries);
+
+/**
+ * @brief Wartet, bis ein weiterer Kanal gescannt oder ein Durchlauf beendet wurde.
+ * @note Für genau einen wartenden Task gedacht (das Fortschritts-Signal wird beim Empfang gelöscht).
+ * @return false bei Zeitüberschreitung.
+ */
+bool wifi_scanner_wait_progress(uint32_t timeout_ms);
@@ -27,9 +27,15 @@ extern "C" void app_main(void) {
 
     // Endlosschleife für die Hauptanwendung
     ESP_LOGI(TAG, "Main application logic can now run. Waiting for WiFi events...");
+    bool timing_logged = false;
     while(true) {
         // Frage die Klasse direkt, ob die Zeit synchron ist.
         if (provisioner.is_time_synchronized()) {
+            // Einmalig ausgeben, wie lange die einzelnen Phasen bis hierher gedauert haben
+            if (!timing_logged) {
+                provisioner.log_boot_timing();
+                timing_logged = true;
+            }
             time_t now;
             struct tm timeinfo;
             char strftime_buf[64];